@@ -1,5 +1,5 @@
 create table sales_orders (
-    id integer primary key,
+    id integer primary key autoincrement,
     state integer not null default 0,
     open_datetime datetime not null default current_timestamp,
     grand_total double not null default 0.0,
@@ -13,16 +13,186 @@ create table sales_orders (
 );
 
 create table sales_order_details (
-  id integer primary key,
+  id integer primary key autoincrement,
   parent_id integer,
   name varchar(100),
   quantity integer not null default 0,
   cost double not null default 0,
   price double not null default 0,
-  profit double not null default 0
+  profit double not null default 0,
+  product_id integer
 );
 
 create table products (
   id integer primary key,
-  name varchar(100) unique not null default ''
-);
\ No newline at end of file
+  name varchar(100) unique not null default '',
+  barcode varchar(50) not null default '',
+  cost double not null default 0,
+  price double not null default 0
+);
+
+create unique index products_barcode on products(barcode) where barcode<>'';
+
+create index sales_order_details_parent_id on sales_order_details(parent_id);
+
+create table change_log (
+  seq integer primary key autoincrement,
+  table_name varchar(50) not null,
+  row_id integer not null,
+  op char(1) not null,
+  origin varchar(50) not null default '',
+  logged_datetime datetime not null default current_timestamp,
+  parent_id integer
+);
+
+create index change_log_origin_seq on change_log(origin, seq);
+
+create table sync_state (
+  key varchar(100) primary key,
+  value text not null default ''
+);
+
+create table sync_row_map (
+  origin varchar(50) not null,
+  table_name varchar(50) not null,
+  origin_id integer not null,
+  local_id integer not null,
+  primary key (origin, table_name, origin_id)
+);
+
+create index sync_row_map_local on sync_row_map(table_name, local_id);
+
+create trigger sales_orders_log_insert after insert on sales_orders begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('sales_orders', new.id, 'I', (select value from sync_state where key='origin'));
+end;
+
+create trigger sales_orders_log_update after update on sales_orders begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('sales_orders', new.id, 'U', (select value from sync_state where key='origin'));
+end;
+
+create trigger sales_orders_log_delete after delete on sales_orders begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('sales_orders', old.id, 'D', (select value from sync_state where key='origin'));
+end;
+
+create trigger sales_order_details_log_insert after insert on sales_order_details begin
+  insert into change_log(table_name, row_id, op, origin, parent_id)
+  values ('sales_order_details', new.id, 'I', (select value from sync_state where key='origin'), new.parent_id);
+end;
+
+create trigger sales_order_details_log_update after update on sales_order_details begin
+  insert into change_log(table_name, row_id, op, origin, parent_id)
+  values ('sales_order_details', new.id, 'U', (select value from sync_state where key='origin'), new.parent_id);
+end;
+
+create trigger sales_order_details_log_delete after delete on sales_order_details begin
+  insert into change_log(table_name, row_id, op, origin, parent_id)
+  values ('sales_order_details', old.id, 'D', (select value from sync_state where key='origin'), old.parent_id);
+end;
+
+create trigger products_log_insert after insert on products begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('products', new.id, 'I', (select value from sync_state where key='origin'));
+end;
+
+create trigger products_log_update after update on products begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('products', new.id, 'U', (select value from sync_state where key='origin'));
+end;
+
+create trigger products_log_delete after delete on products begin
+  insert into change_log(table_name, row_id, op, origin)
+  values ('products', old.id, 'D', (select value from sync_state where key='origin'));
+end;
+
+create index sales_orders_state on sales_orders(state);
+create index sales_orders_open_datetime on sales_orders(open_datetime);
+create index sales_orders_grand_total on sales_orders(grand_total);
+create index sales_orders_customer_name on sales_orders(customer_name collate nocase);
+create index sales_orders_customer_contact on sales_orders(customer_contact collate nocase);
+create index sales_orders_customer_address on sales_orders(customer_address collate nocase);
+
+create table customers (
+  id integer primary key,
+  name varchar(100) not null default '',
+  contact varchar(100) not null default '',
+  address varchar(100) not null default ''
+);
+
+create unique index customers_name_contact on customers(name collate nocase, contact);
+
+create index sales_orders_state_open_datetime on sales_orders(state, open_datetime);
+
+create table stock_movements (
+  id integer primary key,
+  product_id integer not null,
+  quantity integer not null,
+  order_id integer,
+  created_datetime datetime not null default current_timestamp
+);
+
+create index stock_movements_order_product on stock_movements(order_id, product_id);
+
+create table stock_balances (
+  product_id integer primary key,
+  quantity integer not null default 0,
+  tracked integer not null default 0
+);
+
+create trigger stock_movements_post after insert on stock_movements begin
+  insert or ignore into stock_balances(product_id) values (new.product_id);
+  update stock_balances set quantity=quantity+new.quantity,
+    tracked=(tracked or new.order_id is null) where product_id=new.product_id;
+end;
+
+create trigger stock_movements_log after insert on stock_movements begin
+  insert into change_log(table_name, row_id, op, origin) values ('stock_balances', new.product_id, 'U', 'stock');
+end;
+
+create trigger stock_movements_no_update before update on stock_movements begin
+  select raise(abort, 'stock movements are append-only');
+end;
+
+create trigger stock_movements_no_delete before delete on stock_movements begin
+  select raise(abort, 'stock movements are append-only');
+end;
+
+create virtual table sales_order_details_fts using fts5(
+  name, content='sales_order_details', content_rowid='id', prefix='2 3'
+);
+
+create trigger sales_order_details_fts_insert after insert on sales_order_details begin
+  insert into sales_order_details_fts(rowid, name) values (new.id, new.name);
+end;
+
+create trigger sales_order_details_fts_delete after delete on sales_order_details begin
+  insert into sales_order_details_fts(sales_order_details_fts, rowid, name) values ('delete', old.id, old.name);
+end;
+
+create trigger sales_order_details_fts_update after update of id, name on sales_order_details begin
+  insert into sales_order_details_fts(sales_order_details_fts, rowid, name) values ('delete', old.id, old.name);
+  insert into sales_order_details_fts(rowid, name) values (new.id, new.name);
+end;
+
+create virtual table sales_orders_fts using fts5(
+  customer_name, customer_contact, customer_address, content='sales_orders', content_rowid='id'
+);
+
+create trigger sales_orders_fts_insert after insert on sales_orders begin
+  insert into sales_orders_fts(rowid, customer_name, customer_contact, customer_address)
+  values (new.id, new.customer_name, new.customer_contact, new.customer_address);
+end;
+
+create trigger sales_orders_fts_delete after delete on sales_orders begin
+  insert into sales_orders_fts(sales_orders_fts, rowid, customer_name, customer_contact, customer_address)
+  values ('delete', old.id, old.customer_name, old.customer_contact, old.customer_address);
+end;
+
+create trigger sales_orders_fts_update after update of id, customer_name, customer_contact, customer_address on sales_orders begin
+  insert into sales_orders_fts(sales_orders_fts, rowid, customer_name, customer_contact, customer_address)
+  values ('delete', old.id, old.customer_name, old.customer_contact, old.customer_address);
+  insert into sales_orders_fts(rowid, customer_name, customer_contact, customer_address)
+  values (new.id, new.customer_name, new.customer_contact, new.customer_address);
+end;
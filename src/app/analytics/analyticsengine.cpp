@@ -0,0 +1,317 @@
+#include "analyticsengine.h"
+
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QLocale>
+#include <QDate>
+#include <QHash>
+
+namespace {
+
+// Above this many pivot cells each worker accumulates into a hash instead of a dense array.
+const qint64 DenseCellLimit = 1 << 18;
+
+const QDate Epoch(1970, 1, 1);
+
+struct Cell
+{
+    inline Cell()
+        : quantity(0)
+        , revenue(0)
+        , cost(0)
+        , orders(0)
+        , lastOrder(-1)
+    {}
+
+    qint64 quantity;
+    qint64 revenue;
+    qint64 cost;
+    qint64 orders;
+    qint32 lastOrder;
+};
+
+// Maps a dimension onto dense keys 0..count-1 within the queried day range.
+struct Axis
+{
+    AnalyticsEngine::Dimension dimension;
+    qint32 firstDay;
+    qint32 count;
+    QVector<qint32> monthOfDay;
+    QStringList labels;
+};
+
+Axis makeAxis(AnalyticsEngine::Dimension dimension, const SalesSnapshot& snapshot, qint32 firstDay, qint32 lastDay)
+{
+    QLocale locale;
+    Axis axis;
+    axis.dimension = dimension;
+    axis.firstDay = firstDay;
+    axis.count = 1;
+
+    switch (dimension) {
+    case AnalyticsEngine::NoDimension:
+        axis.labels.append("Total");
+        break;
+    case AnalyticsEngine::ProductDimension:
+        axis.count = snapshot.productNames.size();
+        for (const QString& name: snapshot.productNames)
+            axis.labels.append(name);
+        break;
+    case AnalyticsEngine::DayDimension:
+        axis.count = qMax(0, lastDay - firstDay + 1);
+        for (qint32 i = 0; i < axis.count; i++)
+            axis.labels.append(Epoch.addDays(firstDay + i).toString("dd/MM/yyyy"));
+        break;
+    case AnalyticsEngine::WeekDimension:
+        // Weeks start on Monday; 1970-01-01 was a Thursday.
+        axis.firstDay = firstDay - (firstDay + 3) % 7;
+        axis.count = qMax(0, (lastDay - axis.firstDay) / 7 + 1);
+        for (qint32 i = 0; i < axis.count; i++)
+            axis.labels.append(Epoch.addDays(axis.firstDay + i * 7).toString("dd/MM/yyyy"));
+        break;
+    case AnalyticsEngine::MonthDimension: {
+        const QDate first = Epoch.addDays(firstDay);
+        const int firstMonth = first.year() * 12 + first.month() - 1;
+        axis.monthOfDay.resize(qMax(0, lastDay - firstDay + 1));
+        for (int i = 0; i < axis.monthOfDay.size(); i++) {
+            const QDate date = Epoch.addDays(firstDay + i);
+            axis.monthOfDay[i] = date.year() * 12 + date.month() - 1 - firstMonth;
+        }
+        axis.count = axis.monthOfDay.isEmpty() ? 0 : axis.monthOfDay.last() + 1;
+        for (qint32 i = 0; i < axis.count; i++) {
+            const int month = firstMonth + i;
+            axis.labels.append(locale.standaloneMonthName(month % 12 + 1) + " " + QString::number(month / 12));
+        }
+        break;
+    }
+    case AnalyticsEngine::HourDimension:
+        axis.count = 24;
+        for (qint32 i = 0; i < axis.count; i++)
+            axis.labels.append(QString("%1:00").arg(i, 2, 10, QChar('0')));
+        break;
+    case AnalyticsEngine::WeekdayDimension:
+        axis.count = 7;
+        for (qint32 i = 0; i < axis.count; i++)
+            axis.labels.append(locale.standaloneDayName(i + 1));
+        break;
+    }
+
+    return axis;
+}
+
+// Key of an order along an order-level axis.
+inline qint32 orderKey(const Axis& axis, qint32 day, qint32 hour)
+{
+    switch (axis.dimension) {
+    case AnalyticsEngine::DayDimension: return day - axis.firstDay;
+    case AnalyticsEngine::WeekDimension: return (day - axis.firstDay) / 7;
+    case AnalyticsEngine::MonthDimension: return axis.monthOfDay.at(day - axis.firstDay);
+    case AnalyticsEngine::HourDimension: return hour;
+    case AnalyticsEngine::WeekdayDimension: return (day + 3) % 7;
+    default: return 0;
+    }
+}
+
+struct Partial
+{
+    QVector<Cell> dense;
+    QHash<qint64, Cell> sparse;
+};
+
+struct Scan
+{
+    const SalesSnapshot* snapshot;
+    const qint32* orderRowKeys;
+    const qint32* orderColumnKeys;
+    bool productRows;
+    bool productColumns;
+    qint32 columnCount;
+    qint64 cellCount;
+};
+
+// Sums one contiguous run of lines. The inner loop touches only flat arrays so it stays branch-light.
+template <typename CellAt>
+void scanLines(const Scan& scan, int begin, int end, CellAt cellAt)
+{
+    const qint32* lineOrder = scan.snapshot->lineOrder.constData();
+    const qint32* lineProduct = scan.snapshot->lineProduct.constData();
+    const qint32* lineQuantity = scan.snapshot->lineQuantity.constData();
+    const qint64* lineCost = scan.snapshot->lineCost.constData();
+    const qint64* linePrice = scan.snapshot->linePrice.constData();
+
+    for (int i = begin; i < end; i++) {
+        const qint32 order = lineOrder[i];
+        const qint32 rowKey = scan.productRows ? lineProduct[i] : scan.orderRowKeys[order];
+        const qint32 columnKey = scan.productColumns ? lineProduct[i] : scan.orderColumnKeys[order];
+        if (rowKey < 0 || columnKey < 0)
+            continue;
+
+        Cell& cell = cellAt(qint64(rowKey) * scan.columnCount + columnKey);
+        const qint64 quantity = lineQuantity[i];
+        cell.quantity += quantity;
+        cell.revenue += quantity * linePrice[i];
+        cell.cost += quantity * lineCost[i];
+
+        // Lines are grouped by order, so an order is counted once per cell.
+        if (cell.lastOrder != order) {
+            cell.lastOrder = order;
+            cell.orders++;
+        }
+    }
+}
+
+Partial scanChunk(const Scan& scan, int begin, int end)
+{
+    Partial partial;
+
+    if (scan.cellCount <= DenseCellLimit) {
+        partial.dense.resize(scan.cellCount);
+        Cell* cells = partial.dense.data();
+        scanLines(scan, begin, end, [cells](qint64 key) -> Cell& { return cells[key]; });
+    }
+    else {
+        QHash<qint64, Cell>& cells = partial.sparse;
+        scanLines(scan, begin, end, [&cells](qint64 key) -> Cell& { return cells[key]; });
+    }
+
+    return partial;
+}
+
+inline void merge(Cell& into, const Cell& cell)
+{
+    into.quantity += cell.quantity;
+    into.revenue += cell.revenue;
+    into.cost += cell.cost;
+    into.orders += cell.orders;
+}
+
+double measureValue(AnalyticsEngine::Measure measure, const Cell& cell)
+{
+    switch (measure) {
+    case AnalyticsEngine::QuantityMeasure: return cell.quantity;
+    case AnalyticsEngine::RevenueMeasure: return cell.revenue / 100.0;
+    case AnalyticsEngine::CostMeasure: return cell.cost / 100.0;
+    case AnalyticsEngine::ProfitMeasure: return (cell.revenue - cell.cost) / 100.0;
+    case AnalyticsEngine::OrderCountMeasure: return cell.orders;
+    case AnalyticsEngine::AverageBasketMeasure: return cell.orders ? cell.revenue / 100.0 / cell.orders : 0.0;
+    }
+
+    return 0.0;
+}
+
+}
+
+AnalyticsEngine::Result AnalyticsEngine::run(const SalesSnapshot& snapshot, const Query& query)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+
+    const qint32 firstDay = query.toDay < query.fromDay ? snapshot.minDay : qMax(query.fromDay, snapshot.minDay);
+    const qint32 lastDay = query.toDay < query.fromDay ? snapshot.maxDay : qMin(query.toDay, snapshot.maxDay);
+    if (snapshot.lineCount() == 0 || lastDay < firstDay)
+        return result;
+
+    const Axis rows = makeAxis(query.rowDimension, snapshot, firstDay, lastDay);
+    const Axis columns = makeAxis(query.columnDimension == query.rowDimension ? NoDimension : query.columnDimension,
+                                  snapshot, firstDay, lastDay);
+
+    // Resolve the filter and the order-level keys once per order rather than once per line; -1 drops the order.
+    QVector<qint32> orderRowKeys(snapshot.orderCount());
+    QVector<qint32> orderColumnKeys(snapshot.orderCount());
+    for (int i = 0; i < snapshot.orderCount(); i++) {
+        const qint32 day = snapshot.orderDay.at(i);
+        const bool included = day >= firstDay && day <= lastDay
+                && (query.stateFilter < 0 || snapshot.orderState.at(i) == query.stateFilter);
+        orderRowKeys[i] = included ? orderKey(rows, day, snapshot.orderHour.at(i)) : -1;
+        orderColumnKeys[i] = included ? orderKey(columns, day, snapshot.orderHour.at(i)) : -1;
+    }
+
+    Scan scan;
+    scan.snapshot = &snapshot;
+    scan.orderRowKeys = orderRowKeys.constData();
+    scan.orderColumnKeys = orderColumnKeys.constData();
+    scan.productRows = rows.dimension == ProductDimension;
+    scan.productColumns = columns.dimension == ProductDimension;
+    scan.columnCount = columns.count;
+    scan.cellCount = qint64(rows.count) * columns.count;
+
+    // Split at order boundaries so that no order straddles two workers.
+    const int threadCount = qMax(1, QThread::idealThreadCount());
+    const int lineCount = snapshot.lineCount();
+    QVector<int> bounds;
+    bounds.append(0);
+    for (int t = 1; t < threadCount; t++) {
+        int bound = qMax(bounds.last(), int(qint64(lineCount) * t / threadCount));
+        while (bound > 0 && bound < lineCount && snapshot.lineOrder.at(bound) == snapshot.lineOrder.at(bound - 1))
+            bound++;
+        bounds.append(bound);
+    }
+    bounds.append(lineCount);
+
+    QList<QFuture<Partial>> futures;
+    for (int t = 1; t < bounds.size() - 1; t++)
+        futures.append(QtConcurrent::run(scanChunk, scan, bounds.at(t), bounds.at(t + 1)));
+
+    QVector<Cell> cells(scan.cellCount <= DenseCellLimit ? scan.cellCount : 0);
+    QHash<qint64, Cell> sparseCells;
+
+    const auto collect = [&](const Partial& partial) {
+        for (int i = 0; i < partial.dense.size(); i++)
+            merge(cells[i], partial.dense.at(i));
+        for (QHash<qint64, Cell>::const_iterator it = partial.sparse.constBegin(); it != partial.sparse.constEnd(); ++it)
+            merge(sparseCells[it.key()], it.value());
+    };
+
+    collect(scanChunk(scan, bounds.at(0), bounds.at(1)));
+    for (QFuture<Partial>& future: futures)
+        collect(future.result());
+
+    // Keep only rows and columns that have sales in them.
+    QVector<int> rowIndex(rows.count, -1);
+    QVector<int> columnIndex(columns.count, -1);
+    const auto mark = [&](qint64 key) {
+        rowIndex[key / columns.count] = 0;
+        columnIndex[key % columns.count] = 0;
+    };
+
+    for (int i = 0; i < cells.size(); i++) {
+        if (cells.at(i).orders > 0)
+            mark(i);
+    }
+    for (QHash<qint64, Cell>::const_iterator it = sparseCells.constBegin(); it != sparseCells.constEnd(); ++it)
+        mark(it.key());
+
+    for (int i = 0; i < rows.count; i++) {
+        if (rowIndex.at(i) == 0) {
+            rowIndex[i] = result.rowLabels.size();
+            result.rowLabels.append(rows.labels.at(i));
+        }
+    }
+    for (int i = 0; i < columns.count; i++) {
+        if (columnIndex.at(i) == 0) {
+            columnIndex[i] = result.columnLabels.size();
+            result.columnLabels.append(columns.labels.at(i));
+        }
+    }
+
+    result.values.resize(result.rowLabels.size() * result.columnLabels.size());
+    const auto store = [&](qint64 key, const Cell& cell) {
+        const int row = rowIndex.at(key / columns.count);
+        const int column = columnIndex.at(key % columns.count);
+        result.values[row * result.columnLabels.size() + column] = measureValue(query.measure, cell);
+    };
+
+    for (int i = 0; i < cells.size(); i++) {
+        if (cells.at(i).orders > 0)
+            store(i, cells.at(i));
+    }
+    for (QHash<qint64, Cell>::const_iterator it = sparseCells.constBegin(); it != sparseCells.constEnd(); ++it)
+        store(it.key(), it.value());
+
+    result.scannedLines = lineCount;
+    result.elapsed = timer.elapsed();
+    return result;
+}
@@ -0,0 +1,66 @@
+#ifndef ANALYTICSENGINE_H
+#define ANALYTICSENGINE_H
+
+#include "salessnapshot.h"
+
+#include <QStringList>
+
+class AnalyticsEngine
+{
+public:
+    enum Dimension {
+        NoDimension,
+        ProductDimension,
+        DayDimension,
+        WeekDimension,
+        MonthDimension,
+        HourDimension,
+        WeekdayDimension
+    };
+
+    enum Measure {
+        QuantityMeasure,
+        RevenueMeasure,
+        CostMeasure,
+        ProfitMeasure,
+        OrderCountMeasure,
+        AverageBasketMeasure
+    };
+
+    struct Query
+    {
+        inline Query()
+            : rowDimension(ProductDimension)
+            , columnDimension(NoDimension)
+            , measure(RevenueMeasure)
+            , fromDay(0)
+            , toDay(-1)
+            , stateFilter(-1)
+        {}
+
+        Dimension rowDimension;
+        Dimension columnDimension;
+        Measure measure;
+        qint32 fromDay;
+        qint32 toDay;
+        int stateFilter;
+    };
+
+    struct Result
+    {
+        inline Result()
+            : scannedLines(0)
+            , elapsed(0)
+        {}
+
+        QStringList rowLabels;
+        QStringList columnLabels;
+        QVector<double> values;
+        int scannedLines;
+        qint64 elapsed;
+    };
+
+    static Result run(const SalesSnapshot& snapshot, const Query& query);
+};
+
+#endif // ANALYTICSENGINE_H
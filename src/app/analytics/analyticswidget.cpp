@@ -0,0 +1,265 @@
+#include "analyticswidget.h"
+
+#include <QtConcurrent>
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QSqlDatabase>
+#include <QBoxLayout>
+#include <QToolBar>
+#include <QComboBox>
+#include <QDateEdit>
+#include <QTableView>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+
+namespace {
+
+const QDate Epoch(1970, 1, 1);
+
+}
+
+class AnalyticsWidget::Model : public QAbstractTableModel
+{
+public:
+    Model(QObject* parent)
+        : QAbstractTableModel(parent)
+        , textLabels(false)
+        , decimals(0)
+    {
+    }
+
+    void setResult(const AnalyticsEngine::Result& pResult, const QString& pRowTitle, bool pTextLabels, int pDecimals)
+    {
+        beginResetModel();
+        result = pResult;
+        rowTitle = pRowTitle;
+        textLabels = pTextLabels;
+        decimals = pDecimals;
+        endResetModel();
+    }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const
+    {
+        return parent.isValid() ? 0 : result.rowLabels.size();
+    }
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const
+    {
+        return parent.isValid() || result.rowLabels.isEmpty() ? 0 : result.columnLabels.size() + 1;
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const
+    {
+        if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+            return section == 0 ? rowTitle : result.columnLabels.at(section - 1);
+
+        return QVariant();
+    }
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const
+    {
+        if (index.column() == 0) {
+            // Dates and hours sort by position rather than by their label text.
+            if (role == Qt::DisplayRole || (role == Qt::EditRole && textLabels))
+                return result.rowLabels.at(index.row());
+            else if (role == Qt::EditRole)
+                return index.row();
+            return QVariant();
+        }
+
+        const double value = result.values.at(index.row() * result.columnLabels.size() + index.column() - 1);
+
+        if (role == Qt::DisplayRole)
+            return QLocale().toString(value, 'f', decimals);
+        else if (role == Qt::EditRole)
+            return value;
+        else if (role == Qt::TextAlignmentRole)
+            return Qt::AlignRight ^ Qt::AlignVCenter;
+
+        return QVariant();
+    }
+
+private:
+    AnalyticsEngine::Result result;
+    QString rowTitle;
+    bool textLabels;
+    int decimals;
+};
+
+AnalyticsWidget::AnalyticsWidget(QWidget* parent)
+    : QWidget(parent)
+    , model(new Model(this))
+    , proxyModel(new QSortFilterProxyModel(this))
+    , loadWatcher(new QFutureWatcher<SalesSnapshot>(this))
+    , calculateWatcher(new QFutureWatcher<AnalyticsEngine::Result>(this))
+    , recalculatePending(false)
+    , dateRangeSet(false)
+{
+    setWindowTitle("Analitik");
+
+    QToolBar* toolBar = new QToolBar(this);
+    toolBar->setIconSize(QSize(16, 16));
+
+    QAction* reloadAction = toolBar->addAction(QIcon(":/resources/icons/refresh.png"), "", this, SLOT(reload()));
+    reloadAction->setToolTip("Muat ulang data penjualan");
+
+    const QStringList dimensions = QStringList() << "Produk" << "Tanggal" << "Minggu" << "Bulan" << "Jam" << "Hari";
+
+    rowComboBox = new QComboBox(toolBar);
+    rowComboBox->setToolTip("Kelompokkan baris berdasarkan");
+    rowComboBox->addItems(dimensions);
+    toolBar->addWidget(rowComboBox);
+
+    columnComboBox = new QComboBox(toolBar);
+    columnComboBox->setToolTip("Kelompokkan kolom berdasarkan");
+    columnComboBox->addItem("Tanpa Kolom");
+    columnComboBox->addItems(dimensions);
+    toolBar->addWidget(columnComboBox);
+
+    measureComboBox = new QComboBox(toolBar);
+    measureComboBox->setToolTip("Nilai yang dihitung");
+    measureComboBox->addItem("Jumlah Terjual");
+    measureComboBox->addItem("Omzet");
+    measureComboBox->addItem("Modal");
+    measureComboBox->addItem("Laba");
+    measureComboBox->addItem("Jumlah Pesanan");
+    measureComboBox->addItem("Rata-rata Belanja");
+    measureComboBox->setCurrentIndex(AnalyticsEngine::RevenueMeasure);
+    toolBar->addWidget(measureComboBox);
+
+    toolBar->addSeparator();
+
+    stateComboBox = new QComboBox(toolBar);
+    stateComboBox->setToolTip("Saring pesanan berdasarkan status");
+    stateComboBox->addItem("Semua");
+    stateComboBox->addItem("Aktif");
+    stateComboBox->addItem("Selesai");
+    stateComboBox->addItem("Dibatalkan");
+    stateComboBox->setCurrentIndex(2);
+    toolBar->addWidget(stateComboBox);
+
+    fromDateEdit = new QDateEdit(toolBar);
+    fromDateEdit->setToolTip("Dari tanggal");
+    fromDateEdit->setCalendarPopup(true);
+    fromDateEdit->setDisplayFormat("dd/MM/yyyy");
+    toolBar->addWidget(fromDateEdit);
+
+    toDateEdit = new QDateEdit(toolBar);
+    toDateEdit->setToolTip("Sampai tanggal");
+    toDateEdit->setCalendarPopup(true);
+    toDateEdit->setDisplayFormat("dd/MM/yyyy");
+    toolBar->addWidget(toDateEdit);
+
+    proxyModel->setSourceModel(model);
+    proxyModel->setSortRole(Qt::EditRole);
+
+    view = new QTableView(this);
+    view->setModel(proxyModel);
+    view->setAlternatingRowColors(true);
+    view->setSortingEnabled(true);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    QHeaderView* header = view->verticalHeader();
+    header->setVisible(false);
+    header->setDefaultSectionSize(20);
+    header->setSectionResizeMode(QHeaderView::Fixed);
+    header = view->horizontalHeader();
+    header->setHighlightSections(false);
+    header->setSortIndicator(0, Qt::AscendingOrder);
+
+    infoLabel = new QLabel(this);
+    infoLabel->setStyleSheet("font-style:italic;padding-bottom:1px;");
+
+    QBoxLayout* mainLayout = new QVBoxLayout(this);
+    mainLayout->setMargin(0);
+    mainLayout->addWidget(toolBar);
+    mainLayout->addWidget(view);
+    mainLayout->addWidget(infoLabel);
+
+    connect(loadWatcher, SIGNAL(finished()), SLOT(onLoaded()));
+    connect(calculateWatcher, SIGNAL(finished()), SLOT(onCalculated()));
+    connect(rowComboBox, SIGNAL(currentIndexChanged(int)), SLOT(recalculate()));
+    connect(columnComboBox, SIGNAL(currentIndexChanged(int)), SLOT(recalculate()));
+    connect(measureComboBox, SIGNAL(currentIndexChanged(int)), SLOT(recalculate()));
+    connect(stateComboBox, SIGNAL(currentIndexChanged(int)), SLOT(recalculate()));
+    connect(fromDateEdit, SIGNAL(dateChanged(QDate)), SLOT(recalculate()));
+    connect(toDateEdit, SIGNAL(dateChanged(QDate)), SLOT(recalculate()));
+
+    reload();
+}
+
+void AnalyticsWidget::reload()
+{
+    if (loadWatcher->isRunning())
+        return;
+
+    setEnabled(false);
+    infoLabel->setText("Memuat data penjualan...");
+    loadWatcher->setFuture(QtConcurrent::run(SalesSnapshot::load, QSqlDatabase::database().databaseName()));
+}
+
+void AnalyticsWidget::onLoaded()
+{
+    snapshot = loadWatcher->result();
+    setEnabled(true);
+
+    if (!dateRangeSet && snapshot.lineCount() > 0) {
+        dateRangeSet = true;
+        fromDateEdit->blockSignals(true);
+        toDateEdit->blockSignals(true);
+        fromDateEdit->setDate(Epoch.addDays(snapshot.minDay));
+        toDateEdit->setDate(Epoch.addDays(snapshot.maxDay));
+        fromDateEdit->blockSignals(false);
+        toDateEdit->blockSignals(false);
+    }
+
+    recalculate();
+}
+
+AnalyticsEngine::Query AnalyticsWidget::currentQuery() const
+{
+    AnalyticsEngine::Query query;
+    query.rowDimension = AnalyticsEngine::Dimension(rowComboBox->currentIndex() + 1);
+    query.columnDimension = AnalyticsEngine::Dimension(columnComboBox->currentIndex());
+    query.measure = AnalyticsEngine::Measure(measureComboBox->currentIndex());
+    query.fromDay = Epoch.daysTo(fromDateEdit->date());
+    query.toDay = Epoch.daysTo(toDateEdit->date());
+    query.stateFilter = stateComboBox->currentIndex() - 1;
+    return query;
+}
+
+void AnalyticsWidget::recalculate()
+{
+    if (loadWatcher->isRunning())
+        return;
+
+    // Only one query runs at a time; changes made meanwhile are folded into a single rerun.
+    if (calculateWatcher->isRunning()) {
+        recalculatePending = true;
+        return;
+    }
+
+    calculateWatcher->setFuture(QtConcurrent::run(&AnalyticsEngine::run, snapshot, currentQuery()));
+}
+
+void AnalyticsWidget::onCalculated()
+{
+    if (recalculatePending) {
+        recalculatePending = false;
+        recalculate();
+        return;
+    }
+
+    const AnalyticsEngine::Result result = calculateWatcher->result();
+    const AnalyticsEngine::Query query = currentQuery();
+
+    model->setResult(result, rowComboBox->currentText(), query.rowDimension == AnalyticsEngine::ProductDimension,
+                     query.measure == AnalyticsEngine::AverageBasketMeasure ? 2 : 0);
+    view->resizeColumnsToContents();
+
+    infoLabel->setText(QString("%1 item dari %2 pesanan dihitung dalam %3 ms")
+                       .arg(QLocale().toString(result.scannedLines))
+                       .arg(QLocale().toString(snapshot.orderCount()))
+                       .arg(result.elapsed));
+}
@@ -0,0 +1,52 @@
+#ifndef ANALYTICSWIDGET_H
+#define ANALYTICSWIDGET_H
+
+#include "analyticsengine.h"
+
+#include <QWidget>
+#include <QFutureWatcher>
+
+class QComboBox;
+class QDateEdit;
+class QTableView;
+class QLabel;
+class QSortFilterProxyModel;
+
+class AnalyticsWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    AnalyticsWidget(QWidget* parent);
+
+public slots:
+    void reload();
+    void recalculate();
+
+private slots:
+    void onLoaded();
+    void onCalculated();
+
+private:
+    class Model;
+
+    AnalyticsEngine::Query currentQuery() const;
+
+    QComboBox* rowComboBox;
+    QComboBox* columnComboBox;
+    QComboBox* measureComboBox;
+    QComboBox* stateComboBox;
+    QDateEdit* fromDateEdit;
+    QDateEdit* toDateEdit;
+    QTableView* view;
+    QLabel* infoLabel;
+
+    Model* model;
+    QSortFilterProxyModel* proxyModel;
+    QFutureWatcher<SalesSnapshot>* loadWatcher;
+    QFutureWatcher<AnalyticsEngine::Result>* calculateWatcher;
+    SalesSnapshot snapshot;
+    bool recalculatePending;
+    bool dateRangeSet;
+};
+
+#endif // ANALYTICSWIDGET_H
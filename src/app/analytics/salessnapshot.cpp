@@ -0,0 +1,102 @@
+#include "salessnapshot.h"
+#include "db/archiver.h"
+#include "db/preparedquery.h"
+#include "products/productcatalog.h"
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+
+#define EPOCH_DAY(column) "cast(julianday(" column ") - 2440587.5 as integer)"
+#define HOUR(column) "cast(strftime('%H', " column ") as integer)"
+#define MONEY(column) "cast(round(" column " * 100) as integer)"
+
+#define SELECT_ORDER_COLUMNS \
+    "select id, " EPOCH_DAY("open_datetime") ", " HOUR("open_datetime") ", state "
+
+#define SELECT_LINE_COLUMNS \
+    "select parent_id, name, quantity, " MONEY("cost") ", " MONEY("price") " "
+
+namespace {
+
+// Loads may overlap, each on a worker thread of its own, so every load gets a connection name of its own.
+QAtomicInt loadCount;
+
+}
+
+SalesSnapshot::SalesSnapshot()
+    : minDay(0)
+    , maxDay(-1)
+{
+}
+
+SalesSnapshot SalesSnapshot::load(const QString& databaseName)
+{
+    SalesSnapshot snapshot;
+    const QString connectionName = QString("analytics-%1").arg(loadCount.fetchAndAddRelaxed(1));
+
+    {
+        // A connection of its own, so that loading runs off the UI thread and never holds the writer.
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000;QSQLITE_OPEN_READONLY");
+        db.open();
+
+        const bool archived = Archiver::exists(db) && Archiver::attach(db);
+
+        PreparedQuery orders(archived
+                             ? SELECT_ORDER_COLUMNS "from main.sales_orders union all " SELECT_ORDER_COLUMNS "from archive.sales_orders order by id"
+                             : SELECT_ORDER_COLUMNS "from sales_orders order by id", db);
+        orders->exec();
+
+        QHash<qlonglong, qint32> orderIndex;
+        while (orders->next()) {
+            const qint32 day = orders->value(1).toInt();
+            orderIndex.insert(orders->value(0).toLongLong(), snapshot.orderDay.size());
+            snapshot.orderDay.append(day);
+            snapshot.orderHour.append(orders->value(2).toInt());
+            snapshot.orderState.append(orders->value(3).toInt());
+
+            if (snapshot.maxDay < snapshot.minDay) {
+                snapshot.minDay = day;
+                snapshot.maxDay = day;
+            }
+            else {
+                snapshot.minDay = qMin(snapshot.minDay, day);
+                snapshot.maxDay = qMax(snapshot.maxDay, day);
+            }
+        }
+
+        PreparedQuery lines(archived
+                            ? SELECT_LINE_COLUMNS "from main.sales_order_details union all " SELECT_LINE_COLUMNS "from archive.sales_order_details order by parent_id"
+                            : SELECT_LINE_COLUMNS "from sales_order_details order by parent_id", db);
+        lines->exec();
+
+        QHash<QString, qint32> productIndex;
+        while (lines->next()) {
+            const qint32 order = orderIndex.value(lines->value(0).toLongLong(), -1);
+            if (order < 0)
+                continue;
+
+            const QString name = lines->value(1).toString();
+            const QString key = ProductCatalog::normalize(name);
+            QHash<QString, qint32>::const_iterator it = productIndex.constFind(key);
+            if (it == productIndex.constEnd()) {
+                it = productIndex.insert(key, snapshot.productNames.size());
+                snapshot.productNames.append(name.simplified());
+            }
+
+            snapshot.lineOrder.append(order);
+            snapshot.lineProduct.append(it.value());
+            snapshot.lineQuantity.append(lines->value(2).toInt());
+            snapshot.lineCost.append(lines->value(3).toLongLong());
+            snapshot.linePrice.append(lines->value(4).toLongLong());
+        }
+    }
+
+    // The name is never used again, so its prepared statements would only hold the closed connection.
+    PreparedQuery::clearCache(connectionName);
+
+    QSqlDatabase::removeDatabase(connectionName);
+    return snapshot;
+}
@@ -0,0 +1,37 @@
+#ifndef SALESSNAPSHOT_H
+#define SALESSNAPSHOT_H
+
+#include <QVector>
+#include <QString>
+
+// Column-oriented copy of all orders and line items, hot and archived, for analytics.
+class SalesSnapshot
+{
+public:
+    SalesSnapshot();
+
+    static SalesSnapshot load(const QString& databaseName);
+
+    inline int orderCount() const { return orderDay.size(); }
+    inline int lineCount() const { return lineOrder.size(); }
+
+    // Product names in first-seen order; lineProduct indexes into this dictionary.
+    QVector<QString> productNames;
+
+    // One entry per order. Days count from 1970-01-01.
+    QVector<qint32> orderDay;
+    QVector<qint8> orderHour;
+    QVector<qint8> orderState;
+
+    // One entry per line item, grouped by order. Money is in hundredths.
+    QVector<qint32> lineOrder;
+    QVector<qint32> lineProduct;
+    QVector<qint32> lineQuantity;
+    QVector<qint64> lineCost;
+    QVector<qint64> linePrice;
+
+    qint32 minDay;
+    qint32 maxDay;
+};
+
+#endif // SALESSNAPSHOT_H
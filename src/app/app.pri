@@ -0,0 +1,70 @@
+# Everything but the entry point and the main window, shared by the application and the test suites.
+QT += core gui network widgets sql printsupport concurrent
+INCLUDEPATH += $$PWD
+# The online backup opens its own connections through this library, independent of the Qt driver's SQLite.
+LIBS += -lsqlite3
+SOURCES += \
+    $$PWD/analytics/analyticsengine.cpp \
+    $$PWD/analytics/analyticswidget.cpp \
+    $$PWD/analytics/salessnapshot.cpp \
+    $$PWD/customers/customercompletionmodel.cpp \
+    $$PWD/customers/customerdirectory.cpp \
+    $$PWD/diagnostics/application.cpp \
+    $$PWD/diagnostics/memoryaccounting.cpp \
+    $$PWD/diagnostics/stalldetector.cpp \
+    $$PWD/diagnostics/stalloverlay.cpp \
+    $$PWD/db/archiver.cpp \
+    $$PWD/db/backup.cpp \
+    $$PWD/db/changewatcher.cpp \
+    $$PWD/db/preparedquery.cpp \
+    $$PWD/db/schema.cpp \
+    $$PWD/db/writequeue.cpp \
+    $$PWD/products/productcatalog.cpp \
+    $$PWD/products/productdialog.cpp \
+    $$PWD/sales/salesorderdelegate.cpp \
+    $$PWD/sales/salesordermanager.cpp \
+    $$PWD/sales/salesordermodel.cpp \
+    $$PWD/sales/salesorderproxymodel.cpp \
+    $$PWD/sales/salesordersearch.cpp \
+    $$PWD/sales/salesordereditor.cpp \
+    $$PWD/sales/salesordereditorproductmodel.cpp \
+    $$PWD/stock/stockledger.cpp \
+    $$PWD/sync/synchub.cpp \
+    $$PWD/sync/syncengine.cpp
+
+HEADERS  += \
+    $$PWD/analytics/analyticsengine.h \
+    $$PWD/analytics/analyticswidget.h \
+    $$PWD/analytics/salessnapshot.h \
+    $$PWD/customers/customercompletionmodel.h \
+    $$PWD/customers/customerdirectory.h \
+    $$PWD/diagnostics/application.h \
+    $$PWD/diagnostics/memoryaccounting.h \
+    $$PWD/diagnostics/stalldetector.h \
+    $$PWD/diagnostics/stalloverlay.h \
+    $$PWD/db/archiver.h \
+    $$PWD/db/backup.h \
+    $$PWD/db/changewatcher.h \
+    $$PWD/db/preparedquery.h \
+    $$PWD/db/schema.h \
+    $$PWD/db/writequeue.h \
+    $$PWD/products/productcatalog.h \
+    $$PWD/products/productdialog.h \
+    $$PWD/sales/columnschema.h \
+    $$PWD/sales/salesorderdelegate.h \
+    $$PWD/sales/salesordermanager.h \
+    $$PWD/sales/salesordermodel.h \
+    $$PWD/sales/salesorderproxymodel.h \
+    $$PWD/sales/salesordersearch.h \
+    $$PWD/sales/salesordereditor.h \
+    $$PWD/sales/salesordereditorproductmodel.h \
+    $$PWD/stock/stockledger.h \
+    $$PWD/sync/synchub.h \
+    $$PWD/sync/syncengine.h
+
+# The memory panel is for tracking down growth, not for the till: "qmake CONFIG+=diagnostics" builds it in.
+diagnostics {
+    DEFINES += DIAGNOSTICS_BUILD
+    SOURCES += $$PWD/diagnostics/memoryoverlay.cpp
+    HEADERS += $$PWD/diagnostics/memoryoverlay.h
+}
@@ -0,0 +1,48 @@
+#include "customercompletionmodel.h"
+#include "diagnostics/memoryaccounting.h"
+
+namespace {
+
+const int MaxMatches = 50;
+
+}
+
+CustomerCompletionModel::CustomerCompletionModel(CustomerDirectory::Field field, QObject* parent)
+    : QAbstractListModel(parent)
+    , field(field)
+{
+    MemoryAccounting::track(this, "CustomerCompletionModel", [this]() { return MemoryUsage::of(matches); });
+}
+
+int CustomerCompletionModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : matches.size();
+}
+
+QVariant CustomerCompletionModel::data(const QModelIndex& index, int role) const
+{
+    const CustomerDirectory::Customer& customer = CustomerDirectory::instance()->at(matches.at(index.row()));
+
+    if (role == Qt::DisplayRole) {
+        QStringList parts;
+        parts << customer.name;
+        if (!customer.contact.isEmpty())
+            parts << customer.contact;
+        if (!customer.address.isEmpty())
+            parts << customer.address;
+        return parts.join(" - ");
+    }
+    else if (role == Qt::EditRole)
+        return field == CustomerDirectory::NameField ? customer.name : customer.contact;
+    else if (role == CustomerIndexRole)
+        return matches.at(index.row());
+
+    return QVariant();
+}
+
+void CustomerCompletionModel::setPrefix(const QString& prefix)
+{
+    beginResetModel();
+    matches = CustomerDirectory::instance()->match(field, prefix, MaxMatches);
+    endResetModel();
+}
@@ -0,0 +1,28 @@
+#ifndef CUSTOMERCOMPLETIONMODEL_H
+#define CUSTOMERCOMPLETIONMODEL_H
+
+#include <QAbstractListModel>
+#include "customerdirectory.h"
+
+class CustomerCompletionModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum {
+        CustomerIndexRole = Qt::UserRole
+    };
+
+    CustomerCompletionModel(CustomerDirectory::Field field, QObject* parent);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+public slots:
+    void setPrefix(const QString& prefix);
+
+private:
+    CustomerDirectory::Field field;
+    QList<int> matches;
+};
+
+#endif // CUSTOMERCOMPLETIONMODEL_H
@@ -0,0 +1,164 @@
+#include "customerdirectory.h"
+#include "db/preparedquery.h"
+#include "diagnostics/memoryaccounting.h"
+
+#include <QTimer>
+#include <QSqlDatabase>
+
+#include <algorithm>
+
+namespace {
+
+const int BackfillBatchSize = 2000;
+
+}
+
+CustomerDirectory* CustomerDirectory::self = 0;
+
+CustomerDirectory::CustomerDirectory(QObject* parent)
+    : QObject(parent)
+    , indexedBytes(0)
+{
+    self = this;
+
+    MemoryAccounting::track(this, "CustomerDirectory", [this]() -> qint64 {
+        return MemoryUsage::of(customers) + MemoryUsage::of(indexById)
+                + MemoryUsage::of(nameIndex) + MemoryUsage::of(contactIndex) + indexedBytes;
+    });
+}
+
+QString CustomerDirectory::key(Field field, const QString& text)
+{
+    if (field == NameField)
+        return text.simplified().toCaseFolded();
+
+    QString digits;
+    for (const QChar& c: text) {
+        if (c.isDigit())
+            digits.append(c);
+    }
+    return digits;
+}
+
+QList<int> CustomerDirectory::match(Field field, const QString& prefix, int limit) const
+{
+    QList<int> result;
+
+    const QString k = key(field, prefix);
+    if (k.isEmpty())
+        return result;
+
+    const QVector<Key>& keys = field == NameField ? nameIndex : contactIndex;
+    QVector<Key>::const_iterator it = std::lower_bound(keys.constBegin(), keys.constEnd(), Key(k, -1));
+    for (; it != keys.constEnd() && it->first.startsWith(k) && result.size() < limit; ++it)
+        result.append(it->second);
+
+    return result;
+}
+
+void CustomerDirectory::reload()
+{
+    customers.clear();
+    indexById.clear();
+    nameIndex.clear();
+    contactIndex.clear();
+    indexedBytes = 0;
+
+    PreparedQuery q("select id, name, contact, address from customers");
+    q->exec();
+    while (q->next()) {
+        Customer customer;
+        customer.id = q->value(0).toLongLong();
+        customer.name = q->value(1).toString();
+        customer.contact = q->value(2).toString();
+        customer.address = q->value(3).toString();
+        customers.append(customer);
+
+        indexById.insert(customer.id, customers.size() - 1);
+        const QString nameKey = key(NameField, customer.name);
+        nameIndex.append(Key(nameKey, customers.size() - 1));
+        const QString contactKey = key(ContactField, customer.contact);
+        if (!contactKey.isEmpty())
+            contactIndex.append(Key(contactKey, customers.size() - 1));
+
+        indexedBytes += payload(customer) + MemoryUsage::of(nameKey) + MemoryUsage::of(contactKey);
+    }
+
+    std::sort(nameIndex.begin(), nameIndex.end());
+    std::sort(contactIndex.begin(), contactIndex.end());
+
+    emit reloaded();
+}
+
+void CustomerDirectory::update(const Customer& customer)
+{
+    const int i = indexById.value(customer.id, -1);
+    if (i >= 0) {
+        indexedBytes += MemoryUsage::of(customer.address) - MemoryUsage::of(customers.at(i).address);
+        customers[i].address = customer.address;
+        return;
+    }
+
+    customers.append(customer);
+    index(customers.size() - 1);
+}
+
+void CustomerDirectory::index(int i)
+{
+    indexById.insert(customers.at(i).id, i);
+
+    const Key name(key(NameField, customers.at(i).name), i);
+    nameIndex.insert(std::upper_bound(nameIndex.begin(), nameIndex.end(), name), name);
+
+    const Key contact(key(ContactField, customers.at(i).contact), i);
+    if (!contact.first.isEmpty())
+        contactIndex.insert(std::upper_bound(contactIndex.begin(), contactIndex.end(), contact), contact);
+
+    indexedBytes += payload(customers.at(i)) + MemoryUsage::of(name.first) + MemoryUsage::of(contact.first);
+}
+
+qint64 CustomerDirectory::payload(const Customer& customer)
+{
+    return MemoryUsage::of(customer.name) + MemoryUsage::of(customer.contact) + MemoryUsage::of(customer.address);
+}
+
+void CustomerDirectory::backfill()
+{
+    qlonglong before;
+    {
+        PreparedQuery q("select value from sync_state where key='customer_backfill_before'");
+        q->exec();
+        before = q->next() ? q->value(0).toLongLong() : 0;
+    }
+
+    if (before <= 1)
+        return;
+
+    // Newest orders first, so the latest address of a returning customer is the one kept.
+    const qlonglong after = qMax(Q_INT64_C(0), before - BackfillBatchSize - 1);
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    {
+        PreparedQuery q("insert or ignore into customers (name, contact, address)"
+                        " select customer_name, customer_contact, customer_address from sales_orders"
+                        " where id>? and id<? and customer_name<>'' order by id desc");
+        q->bindValue(0, after);
+        q->bindValue(1, before);
+        q->exec();
+
+        PreparedQuery state("update sync_state set value=? where key='customer_backfill_before'");
+        state->bindValue(0, after + 1);
+        state->exec();
+    }
+
+    if (!db.commit()) {
+        db.rollback();
+        return;
+    }
+
+    if (after > 0)
+        QTimer::singleShot(0, this, SLOT(backfill()));
+    else
+        reload();
+}
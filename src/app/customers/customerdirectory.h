@@ -0,0 +1,63 @@
+#ifndef CUSTOMERDIRECTORY_H
+#define CUSTOMERDIRECTORY_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+class CustomerDirectory : public QObject
+{
+    Q_OBJECT
+public:
+    struct Customer
+    {
+        inline Customer() : id(0) {}
+
+        qlonglong id;
+        QString name;
+        QString contact;
+        QString address;
+    };
+
+    enum Field {
+        NameField,
+        ContactField
+    };
+
+    CustomerDirectory(QObject* parent);
+
+    static inline CustomerDirectory* instance() { return self; }
+
+    inline int count() const { return customers.size(); }
+    inline const Customer& at(int index) const { return customers.at(index); }
+
+    QList<int> match(Field field, const QString& prefix, int limit) const;
+    void update(const Customer& customer);
+
+signals:
+    void reloaded();
+
+public slots:
+    void reload();
+    void backfill();
+
+private:
+    typedef QPair<QString, int> Key;
+
+    static QString key(Field field, const QString& text);
+    void index(int i);
+    static qint64 payload(const Customer& customer);
+
+    static CustomerDirectory* self;
+
+    QVector<Customer> customers;
+    QHash<qlonglong, int> indexById;
+    QVector<Key> nameIndex;
+    QVector<Key> contactIndex;
+
+    // String bytes of the customers and their keys, so that accounting never walks the directory.
+    qint64 indexedBytes;
+};
+
+#endif // CUSTOMERDIRECTORY_H
@@ -0,0 +1,248 @@
+#include "archiver.h"
+#include "schema.h"
+#include "preparedquery.h"
+#include "sales/columnschema.h"
+
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QStringList>
+#include <QDebug>
+
+#define SALES_ORDER_COLUMNS SALES_ORDER_TABLE_COLUMNS(TABLE_COLUMN_NAME_FIRST, TABLE_COLUMN_NAME_NEXT)
+#define SALES_ORDER_DETAIL_COLUMNS SALES_ORDER_DETAIL_TABLE_COLUMNS(TABLE_COLUMN_NAME_FIRST, TABLE_COLUMN_NAME_NEXT)
+
+Archiver::Archiver(QObject* parent)
+    : QObject(parent)
+    , timer(new QTimer(this))
+    , days(0)
+    , ticket(0)
+{
+    connect(timer, SIGNAL(timeout()), SLOT(run()));
+    connect(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)), SLOT(onWriteFinished(int,bool,QVariantMap)));
+}
+
+void Archiver::start(int pDays)
+{
+    days = pDays;
+    if (days <= 0)
+        return;
+
+    timer->start(24 * 60 * 60 * 1000);
+    QTimer::singleShot(60 * 1000, this, SLOT(run()));
+}
+
+void Archiver::run()
+{
+    if (ticket)
+        return;
+
+    // The archive is created here the first time; the writer attaches it before its next batch.
+    if (!attach(QSqlDatabase::database(), true))
+        return;
+
+    ticket = WriteQueue::instance()->submit(archiveJob(days, QDate::currentDate()));
+}
+
+void Archiver::onWriteFinished(int pTicket, bool ok, const QVariantMap& result)
+{
+    if (pTicket != ticket)
+        return;
+
+    ticket = 0;
+
+    const int count = result.value("count").toInt();
+    if (ok && count > 0)
+        emit archived(count);
+}
+
+QString Archiver::fileName(const QSqlDatabase& db)
+{
+    QFileInfo info(db.databaseName());
+    return info.absoluteDir().filePath(info.completeBaseName() + "-archive.sqlite3");
+}
+
+bool Archiver::exists(QSqlDatabase db)
+{
+    return QFileInfo(fileName(db)).exists();
+}
+
+bool Archiver::isAttached(const QSqlDatabase& db)
+{
+    QSqlQuery q(db);
+    q.exec("pragma database_list");
+    while (q.next()) {
+        if (q.value(1).toString() == "archive")
+            return true;
+    }
+    return false;
+}
+
+bool Archiver::attach(QSqlDatabase db, bool create)
+{
+    if (isAttached(db))
+        return true;
+
+    if (!create && !exists(db))
+        return false;
+
+    QSqlQuery q(db);
+    q.prepare("attach database ? as archive");
+    q.bindValue(0, fileName(db));
+    if (!q.exec()) {
+        qWarning() << "Failed to attach archive database:" << q.lastError().text();
+        return false;
+    }
+
+    const QStringList schema = QStringList()
+            << "create table if not exists archive.sales_orders ("
+               SALES_ORDER_TABLE_COLUMNS(TABLE_COLUMN_DEFINITION_FIRST, TABLE_COLUMN_DEFINITION_NEXT) ")"
+            << "create table if not exists archive.sales_order_details ("
+               SALES_ORDER_DETAIL_TABLE_COLUMNS(TABLE_COLUMN_DEFINITION_FIRST, TABLE_COLUMN_DEFINITION_NEXT) ")"
+            << "create index if not exists archive.sales_orders_state on sales_orders(state)"
+            << "create index if not exists archive.sales_orders_state_open_datetime on sales_orders(state, open_datetime)"
+            << "create index if not exists archive.sales_orders_open_datetime on sales_orders(open_datetime)"
+            << "create index if not exists archive.sales_orders_grand_total on sales_orders(grand_total)"
+            << "create index if not exists archive.sales_orders_customer_name on sales_orders(customer_name collate nocase)"
+            << "create index if not exists archive.sales_orders_customer_contact on sales_orders(customer_contact collate nocase)"
+            << "create index if not exists archive.sales_orders_customer_address on sales_orders(customer_address collate nocase)"
+            << "create index if not exists archive.sales_order_details_parent_id on sales_order_details(parent_id)";
+
+    for (const QString& sql: schema)
+        q.exec(sql);
+
+    // Archives made before lines recorded their product get the column, so that restored lines keep it.
+    bool hasProductId = false;
+    q.exec("pragma archive.table_info(sales_order_details)");
+    while (q.next()) {
+        if (q.value(1).toString() == "product_id")
+            hasProductId = true;
+    }
+    if (!hasProductId)
+        q.exec("alter table archive.sales_order_details add column product_id integer");
+
+    // The order list searches the archive like the hot table; archives made before the index get it built once.
+    q.exec("select 1 from archive.sqlite_master where name='sales_orders_fts'");
+    const bool indexed = q.next();
+    q.finish();
+
+    if (!indexed) {
+        for (const QString& sql: Schema::orderSearchIndex("archive"))
+            q.exec(sql);
+        q.exec("insert into archive.sales_orders_fts(sales_orders_fts) values ('rebuild')");
+    }
+
+    return true;
+}
+
+bool Archiver::contains(qlonglong id, QSqlDatabase db)
+{
+    if (!attach(db))
+        return false;
+
+    PreparedQuery q("select 1 from archive.sales_orders where id=?", db);
+    q->bindValue(0, id);
+    q->exec();
+    return q->next();
+}
+
+WriteQueue::Job Archiver::archiveJob(int days, const QDate& today)
+{
+    const QString cutoff = today.addDays(-days).toString(Qt::ISODate);
+
+    return [cutoff](QSqlDatabase& db, QVariantMap& result) {
+        if (!isAttached(db))
+            return false;
+
+        // Hot ids are AUTOINCREMENT, so an archived id is never handed out again. The sequences are raised past
+        // the archive as well, for ids archived before that, when the newest order had to stay behind.
+        const QStringList statements = QStringList()
+                << "insert into main.sqlite_sequence (name, seq) select 'sales_orders', 0"
+                   " where not exists (select 1 from main.sqlite_sequence where name='sales_orders')"
+                << "insert into main.sqlite_sequence (name, seq) select 'sales_order_details', 0"
+                   " where not exists (select 1 from main.sqlite_sequence where name='sales_order_details')"
+                << "update main.sqlite_sequence set seq=max(seq, (select coalesce(max(id), 0) from archive.sales_orders))"
+                   " where name='sales_orders'"
+                << "update main.sqlite_sequence set seq=max(seq, (select coalesce(max(id), 0) from archive.sales_order_details))"
+                   " where name='sales_order_details'"
+                << "create temp table if not exists archive_ids (id integer primary key)"
+                << "delete from temp.archive_ids"
+                << "insert into temp.archive_ids select id from main.sales_orders"
+                   " where state in (1, 2) and open_datetime<:cutoff"
+                // Deleted first rather than replaced, so the archive's search index sees the old row go.
+                << "delete from archive.sales_orders where id in (select id from temp.archive_ids)"
+                << "insert into archive.sales_orders (" SALES_ORDER_COLUMNS ")"
+                   " select " SALES_ORDER_COLUMNS " from main.sales_orders where id in (select id from temp.archive_ids)"
+                << "insert or replace into archive.sales_order_details (" SALES_ORDER_DETAIL_COLUMNS ")"
+                   " select " SALES_ORDER_DETAIL_COLUMNS " from main.sales_order_details"
+                   " where parent_id in (select id from temp.archive_ids)"
+                << "delete from main.sales_order_details where parent_id in (select id from temp.archive_ids)"
+                << "delete from main.sales_orders where id in (select id from temp.archive_ids)";
+
+        // Moving rows out is local housekeeping, not something other terminals should replay.
+        if (!setOrigin(db, "archive"))
+            return false;
+
+        // Each statement is prepared only after the one before it ran, once the temp table exists.
+        for (const QString& sql: statements) {
+            PreparedQuery q(sql, db);
+            if (sql.contains(":cutoff"))
+                q->bindValue(":cutoff", cutoff);
+            if (!q->exec()) {
+                qWarning() << "Archiving closed orders failed:" << q->lastError().text();
+                return false;
+            }
+            if (sql.startsWith("insert into temp.archive_ids"))
+                result.insert("count", q->numRowsAffected());
+        }
+
+        return setOrigin(db, QString());
+    };
+}
+
+WriteQueue::Job Archiver::restoreJob(qlonglong id)
+{
+    return [id](QSqlDatabase& db, QVariantMap& result) {
+        if (!isAttached(db))
+            return false;
+
+        // Line ids that have been reused in the hot database since archiving get fresh ones.
+        const QStringList statements = QStringList()
+                << "insert into main.sales_orders (" SALES_ORDER_COLUMNS ")"
+                   " select " SALES_ORDER_COLUMNS " from archive.sales_orders where id=:id"
+                << "insert into main.sales_order_details (" SALES_ORDER_DETAIL_COLUMNS ")"
+                   " select case when exists (select 1 from main.sales_order_details m where m.id=a.id) then null else a.id end"
+                   SALES_ORDER_DETAIL_TABLE_COLUMNS(TABLE_COLUMN_SKIP, TABLE_COLUMN_NAME_NEXT)
+                   " from archive.sales_order_details a where parent_id=:id"
+                << "delete from archive.sales_order_details where parent_id=:id"
+                << "delete from archive.sales_orders where id=:id";
+
+        if (!setOrigin(db, "archive"))
+            return false;
+
+        for (const QString& sql: statements) {
+            PreparedQuery q(sql, db);
+            q->bindValue(":id", id);
+            if (!q->exec()) {
+                qWarning() << "Restoring archived order failed:" << q->lastError().text();
+                return false;
+            }
+            // Restored already, or never archived.
+            if (sql.startsWith("insert into main.sales_orders") && q->numRowsAffected() == 0)
+                return false;
+        }
+
+        result.insert("id", id);
+        return setOrigin(db, QString());
+    };
+}
+
+bool Archiver::setOrigin(const QSqlDatabase& db, const QString& origin)
+{
+    PreparedQuery q("update sync_state set value=? where key='origin'", db);
+    q->bindValue(0, origin);
+    return q->exec();
+}
@@ -0,0 +1,48 @@
+#ifndef ARCHIVER_H
+#define ARCHIVER_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QDate>
+
+#include "writequeue.h"
+
+class QTimer;
+
+class Archiver : public QObject
+{
+    Q_OBJECT
+public:
+    Archiver(QObject* parent);
+
+    void start(int days);
+
+    static bool exists(QSqlDatabase db = QSqlDatabase::database());
+    static bool attach(QSqlDatabase db = QSqlDatabase::database(), bool create = false);
+    static bool contains(qlonglong id, QSqlDatabase db = QSqlDatabase::database());
+
+    // Both run on the writer, which attaches the archive before each batch. The archive job puts the number
+    // of orders it moved in "count".
+    static WriteQueue::Job archiveJob(int days, const QDate& today);
+    static WriteQueue::Job restoreJob(qlonglong id);
+
+signals:
+    void archived(int count);
+
+public slots:
+    void run();
+
+private slots:
+    void onWriteFinished(int ticket, bool ok, const QVariantMap& result);
+
+private:
+    static QString fileName(const QSqlDatabase& db);
+    static bool isAttached(const QSqlDatabase& db);
+    static bool setOrigin(const QSqlDatabase& db, const QString& origin);
+
+    QTimer* timer;
+    int days;
+    int ticket;
+};
+
+#endif // ARCHIVER_H
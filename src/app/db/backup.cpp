@@ -0,0 +1,179 @@
+#include "backup.h"
+
+#include <QtConcurrent>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThread>
+#include <QDebug>
+
+#include <sqlite3.h>
+
+namespace {
+
+// How long the source waits for a checkpoint or recovery in progress before giving up.
+const int BusyTimeout = 5000;
+
+// Pages copied per step, and the pause between steps that lets the writer in.
+const int PagesPerStep = 64;
+const int StepPause = 5;
+
+}
+
+Backup::Backup(const QString& databaseName, QObject* parent)
+    : QObject(parent)
+    , databaseName(databaseName)
+    , generations(0)
+    , timer(new QTimer(this))
+    , watcher(new QFutureWatcher<QString>(this))
+{
+    connect(timer, SIGNAL(timeout()), SLOT(run()));
+    connect(watcher, SIGNAL(finished()), SLOT(onFinished()));
+}
+
+Backup::~Backup()
+{
+    // The copy holds its own connections; let it finish before the application closes the database.
+    watcher->waitForFinished();
+}
+
+void Backup::start(int minutes, int pGenerations, const QString& pDirectory)
+{
+    generations = pGenerations;
+    directory = pDirectory.isEmpty() ? QFileInfo(databaseName).absoluteDir().filePath("backups") : pDirectory;
+
+    if (minutes <= 0 || generations <= 0)
+        return;
+
+    timer->start(minutes * 60 * 1000);
+}
+
+void Backup::run()
+{
+    if (watcher->isRunning())
+        return;
+
+    watcher->setFuture(QtConcurrent::run(&Backup::backup, databaseName, directory, generations));
+}
+
+void Backup::onFinished()
+{
+    const QString fileName = watcher->result();
+    emit finished(!fileName.isEmpty(), fileName);
+}
+
+QString Backup::backup(const QString& databaseName, const QString& directory, int generations)
+{
+    if (!QDir().mkpath(directory)) {
+        qWarning() << "Backup: cannot create" << directory;
+        return QString();
+    }
+
+    const QString baseName = QFileInfo(databaseName).completeBaseName();
+    const QString fileName = QDir(directory).filePath(
+                baseName + "-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".sqlite3");
+    const QString partFileName = fileName + ".part";
+
+    QFile::remove(partFileName);
+
+    // Pool threads are shared, so the lowered priority only lasts for this copy.
+    QThread* thread = QThread::currentThread();
+    const QThread::Priority priority = thread->priority();
+    thread->setPriority(QThread::LowPriority);
+    const bool copied = copy(databaseName, partFileName);
+    thread->setPriority(priority);
+
+    // Only a complete, verified copy ever gets a generation's name.
+    if (!copied || !verify(partFileName) || !QFile::rename(partFileName, fileName)) {
+        QFile::remove(partFileName);
+        return QString();
+    }
+
+    rotate(directory, baseName, generations);
+    return fileName;
+}
+
+bool Backup::copy(const QString& databaseName, const QString& fileName)
+{
+    sqlite3* source = 0;
+    sqlite3* target = 0;
+    bool ok = false;
+
+    // Both ends are opened through the library linked here; handles borrowed from the Qt driver may
+    // belong to its bundled SQLite, whose structures this library must never touch.
+    if (sqlite3_open_v2(QFile::encodeName(databaseName).constData(), &source, SQLITE_OPEN_READONLY, 0) != SQLITE_OK
+            || sqlite3_open_v2(QFile::encodeName(fileName).constData(), &target,
+                               SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0) != SQLITE_OK) {
+        qWarning() << "Backup: cannot open databases:"
+                   << (source ? sqlite3_errmsg(source) : "") << (target ? sqlite3_errmsg(target) : "");
+    }
+    else {
+        sqlite3_busy_timeout(source, BusyTimeout);
+
+        // A read transaction pins one WAL snapshot for the whole copy, so commits made between steps
+        // neither tear the copy nor restart it, and the writer is never locked out.
+        const bool pinned = sqlite3_exec(source, "begin; select count(*) from sqlite_master", 0, 0, 0) == SQLITE_OK;
+        if (!pinned)
+            qWarning() << "Backup: cannot start read transaction:" << sqlite3_errmsg(source);
+
+        sqlite3_backup* backup = pinned ? sqlite3_backup_init(target, "main", source, "main") : 0;
+        if (backup) {
+            int rc;
+            do {
+                rc = sqlite3_backup_step(backup, PagesPerStep);
+                if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                    QThread::msleep(StepPause);
+            } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+
+            ok = rc == SQLITE_DONE;
+            if (!ok)
+                qWarning() << "Backup: step failed:" << sqlite3_errstr(rc);
+
+            if (sqlite3_backup_finish(backup) != SQLITE_OK)
+                ok = false;
+        }
+        else if (pinned)
+            qWarning() << "Backup: init failed:" << sqlite3_errmsg(target);
+
+        sqlite3_exec(source, "rollback", 0, 0, 0);
+    }
+
+    // sqlite3_open_v2 hands back a connection even when it fails, and closing null is a no-op.
+    sqlite3_close(source);
+    sqlite3_close(target);
+    return ok;
+}
+
+bool Backup::verify(const QString& fileName)
+{
+    sqlite3* db = 0;
+    sqlite3_stmt* statement = 0;
+    bool ok = false;
+
+    if (sqlite3_open_v2(QFile::encodeName(fileName).constData(), &db, SQLITE_OPEN_READONLY, 0) == SQLITE_OK
+            && sqlite3_prepare_v2(db, "pragma integrity_check", -1, &statement, 0) == SQLITE_OK) {
+        QString result;
+        if (sqlite3_step(statement) == SQLITE_ROW)
+            result = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)));
+
+        ok = result == "ok";
+        if (!ok)
+            qWarning() << "Backup: integrity check failed for" << fileName << result;
+    }
+    else
+        qWarning() << "Backup: cannot check" << fileName << sqlite3_errmsg(db);
+
+    sqlite3_finalize(statement);
+    sqlite3_close(db);
+    return ok;
+}
+
+void Backup::rotate(const QString& directory, const QString& baseName, int generations)
+{
+    // Timestamped names sort chronologically, newest first under QDir::Reversed.
+    const QFileInfoList files = QDir(directory).entryInfoList(QStringList() << baseName + "-*.sqlite3",
+                                                              QDir::Files, QDir::Name | QDir::Reversed);
+    for (int i = generations; i < files.size(); i++)
+        QFile::remove(files.at(i).absoluteFilePath());
+}
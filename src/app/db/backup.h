@@ -0,0 +1,41 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <QObject>
+#include <QFutureWatcher>
+
+class QTimer;
+
+class Backup : public QObject
+{
+    Q_OBJECT
+public:
+    Backup(const QString& databaseName, QObject* parent);
+    ~Backup();
+
+    void start(int minutes, int generations, const QString& directory = QString());
+
+    static QString backup(const QString& databaseName, const QString& directory, int generations);
+
+signals:
+    void finished(bool ok, const QString& fileName);
+
+public slots:
+    void run();
+
+private slots:
+    void onFinished();
+
+private:
+    static bool copy(const QString& databaseName, const QString& fileName);
+    static bool verify(const QString& fileName);
+    static void rotate(const QString& directory, const QString& baseName, int generations);
+
+    QString databaseName;
+    QString directory;
+    int generations;
+    QTimer* timer;
+    QFutureWatcher<QString>* watcher;
+};
+
+#endif // BACKUP_H
@@ -0,0 +1,96 @@
+#include "changewatcher.h"
+#include "preparedquery.h"
+
+#include <QTimer>
+#include <QSqlQuery>
+
+ChangeWatcher::ChangeWatcher(QObject* parent, QSqlDatabase db)
+    : QObject(parent)
+    , db(db)
+    , timer(new QTimer(this))
+    , dataVersion(-1)
+    , lastSeq(0)
+{
+    connect(timer, SIGNAL(timeout()), SLOT(poll()));
+}
+
+void ChangeWatcher::start(int interval)
+{
+    QSqlQuery q(db);
+    q.exec("pragma data_version");
+    if (q.next())
+        dataVersion = q.value(0).toLongLong();
+
+    // Once, for whatever moved while the till was closed; later polls name the rows that changed.
+    emit changed();
+
+    PreparedQuery last("select max(seq) from change_log", db);
+    last->exec();
+    if (last->next())
+        lastSeq = last->value(0).toLongLong();
+
+    if (interval > 0)
+        timer->start(interval);
+}
+
+void ChangeWatcher::poll()
+{
+    // data_version only moves when another connection commits, so an idle poll is a single pragma.
+    QSqlQuery q(db);
+    q.exec("pragma data_version");
+    if (!q.next() || q.value(0).toLongLong() == dataVersion)
+        return;
+
+    dataVersion = q.value(0).toLongLong();
+
+    PreparedQuery last("select max(seq) from change_log", db);
+    last->exec();
+    const qlonglong seq = last->next() ? last->value(0).toLongLong() : lastSeq;
+    if (seq <= lastSeq)
+        return;
+
+    // Archive moves are not edits; the hot and archived copies of an order are identical.
+    QList<qlonglong> orderIds = changedIds(
+                "select distinct row_id from change_log"
+                " where seq>? and seq<=? and table_name='sales_orders' and origin<>'archive'", lastSeq, seq);
+
+    for (qlonglong id: changedIds(
+             "select distinct parent_id from change_log"
+             " where seq>? and seq<=? and table_name='sales_order_details' and origin<>'archive'"
+             " and parent_id is not null", lastSeq, seq)) {
+        if (!orderIds.contains(id))
+            orderIds.append(id);
+    }
+
+    const QList<qlonglong> productIds = changedIds(
+                "select distinct row_id from change_log"
+                " where seq>? and seq<=? and table_name='products'", lastSeq, seq);
+
+    const QList<qlonglong> stockIds = changedIds(
+                "select distinct row_id from change_log"
+                " where seq>? and seq<=? and table_name='stock_balances'", lastSeq, seq);
+
+    lastSeq = seq;
+
+    if (!orderIds.isEmpty())
+        emit ordersChanged(orderIds);
+
+    if (!productIds.isEmpty())
+        emit productsChanged(productIds);
+
+    if (!stockIds.isEmpty())
+        emit stockChanged(stockIds);
+}
+
+QList<qlonglong> ChangeWatcher::changedIds(const QString& sql, qlonglong lastSeq, qlonglong seq) const
+{
+    PreparedQuery q(sql, db);
+    q->bindValue(0, lastSeq);
+    q->bindValue(1, seq);
+    q->exec();
+
+    QList<qlonglong> ids;
+    while (q->next())
+        ids.append(q->value(0).toLongLong());
+    return ids;
+}
@@ -0,0 +1,35 @@
+#ifndef CHANGEWATCHER_H
+#define CHANGEWATCHER_H
+
+#include <QObject>
+#include <QSqlDatabase>
+
+class QTimer;
+
+class ChangeWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    ChangeWatcher(QObject* parent, QSqlDatabase db = QSqlDatabase::database());
+
+    void start(int interval);
+
+signals:
+    void changed();
+    void ordersChanged(const QList<qlonglong>& orderIds);
+    void productsChanged(const QList<qlonglong>& productIds);
+    void stockChanged(const QList<qlonglong>& productIds);
+
+public slots:
+    void poll();
+
+private:
+    QList<qlonglong> changedIds(const QString& sql, qlonglong lastSeq, qlonglong seq) const;
+
+    QSqlDatabase db;
+    QTimer* timer;
+    qlonglong dataVersion;
+    qlonglong lastSeq;
+};
+
+#endif // CHANGEWATCHER_H
@@ -0,0 +1,78 @@
+#include "preparedquery.h"
+
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+typedef QHash<QString, QSqlQuery*> Statements;
+
+// Connections are bound to the thread that opened them, so each thread keeps its own cache.
+QThreadStorage<QHash<QString, Statements>*> caches;
+
+QMutex recordingMutex;
+bool recording = false;
+QSet<QString> recorded;
+
+Statements& statements(const QString& connectionName)
+{
+    if (!caches.hasLocalData())
+        caches.setLocalData(new QHash<QString, Statements>);
+
+    return (*caches.localData())[connectionName];
+}
+
+}
+
+PreparedQuery::PreparedQuery(const QString& sql, const QSqlDatabase& db)
+{
+    Statements& cache = statements(db.connectionName());
+
+    query = cache.value(sql);
+    if (!query) {
+        query = new QSqlQuery(db);
+
+        // Results are only ever read front to back; the driver then keeps no copy of the rows already read.
+        query->setForwardOnly(true);
+        if (!query->prepare(sql))
+            qWarning() << "Failed to prepare statement:" << query->lastError().text() << sql;
+        cache.insert(sql, query);
+
+        QMutexLocker locker(&recordingMutex);
+        if (recording)
+            recorded.insert(sql);
+    }
+}
+
+PreparedQuery::~PreparedQuery()
+{
+    // Releases the statement's read snapshot; the compiled statement stays cached.
+    query->finish();
+}
+
+void PreparedQuery::clearCache(const QString& connectionName)
+{
+    Statements& cache = statements(connectionName);
+    qDeleteAll(cache);
+    cache.clear();
+}
+
+void PreparedQuery::setRecording(bool enabled)
+{
+    QMutexLocker locker(&recordingMutex);
+    recording = enabled;
+    if (!enabled)
+        recorded.clear();
+}
+
+QStringList PreparedQuery::recordedStatements()
+{
+    QMutexLocker locker(&recordingMutex);
+    QStringList statements = recorded.toList();
+    statements.sort();
+    return statements;
+}
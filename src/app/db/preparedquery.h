@@ -0,0 +1,29 @@
+#ifndef PREPAREDQUERY_H
+#define PREPAREDQUERY_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+
+class PreparedQuery
+{
+public:
+    PreparedQuery(const QString& sql, const QSqlDatabase& db = QSqlDatabase::database());
+    ~PreparedQuery();
+
+    inline QSqlQuery* operator->() const { return query; }
+    inline QSqlQuery& operator*() const { return *query; }
+
+    static void clearCache(const QString& connectionName = QSqlDatabase::defaultConnection);
+
+    // Remembers every distinct statement prepared on any thread, for the query plan check.
+    static void setRecording(bool enabled);
+    static QStringList recordedStatements();
+
+private:
+    Q_DISABLE_COPY(PreparedQuery)
+
+    QSqlQuery* query;
+};
+
+#endif // PREPAREDQUERY_H
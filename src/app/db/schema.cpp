@@ -0,0 +1,304 @@
+#include "schema.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QStringList>
+#include <QDebug>
+
+namespace {
+
+// Lines also log the order they belong to, so that a deleted line still names its order.
+QStringList changeLogTriggers(const QString& table, const QString& parentColumn = QString())
+{
+    const QString sql("create trigger if not exists %1_log_%4 after %4 on %1 begin"
+                      " insert into change_log(table_name, row_id, op, origin%5)"
+                      " values ('%1', %2.id, '%3', (select value from sync_state where key='origin')%6);"
+                      " end");
+    const QString column = parentColumn.isEmpty() ? QString() : QString(", parent_id");
+    const QString value = parentColumn.isEmpty() ? QString() : ", %1." + parentColumn;
+
+    return QStringList()
+            << sql.arg(table, "new", "I", "insert", column, value.isEmpty() ? value : value.arg("new"))
+            << sql.arg(table, "new", "U", "update", column, value.isEmpty() ? value : value.arg("new"))
+            << sql.arg(table, "old", "D", "delete", column, value.isEmpty() ? value : value.arg("old"));
+}
+
+QStringList fullTextTriggers()
+{
+    return QStringList()
+            << "create trigger sales_order_details_fts_insert after insert on sales_order_details begin"
+               " insert into sales_order_details_fts(rowid, name) values (new.id, new.name);"
+               " end"
+            << "create trigger sales_order_details_fts_delete after delete on sales_order_details begin"
+               " insert into sales_order_details_fts(sales_order_details_fts, rowid, name) values ('delete', old.id, old.name);"
+               " end"
+            << "create trigger sales_order_details_fts_update after update of id, name on sales_order_details begin"
+               " insert into sales_order_details_fts(sales_order_details_fts, rowid, name) values ('delete', old.id, old.name);"
+               " insert into sales_order_details_fts(rowid, name) values (new.id, new.name);"
+               " end";
+}
+
+QList<QStringList> migrations()
+{
+    QList<QStringList> list;
+
+    list << (QStringList()
+             << "create table if not exists sales_orders ("
+                " id integer primary key,"
+                " state integer not null default 0,"
+                " open_datetime datetime not null default current_timestamp,"
+                " grand_total double not null default 0.0,"
+                " revenue double not null default 0.0,"
+                " customer_name varchar(100) not null default '',"
+                " customer_contact varchar(100) not null default '',"
+                " customer_address varchar(100) not null default '',"
+                " lastmod_datetime datetime not null default current_timestamp"
+                ")"
+             << "create table if not exists sales_order_details ("
+                " id integer primary key,"
+                " parent_id integer,"
+                " name varchar(100),"
+                " quantity integer not null default 0,"
+                " cost double not null default 0,"
+                " price double not null default 0,"
+                " profit double not null default 0"
+                ")"
+             << "create table if not exists products ("
+                " id integer primary key,"
+                " name varchar(100) unique not null default ''"
+                ")");
+
+    list << (QStringList()
+             << "create table change_log ("
+                " seq integer primary key autoincrement,"
+                " table_name varchar(50) not null,"
+                " row_id integer not null,"
+                " op char(1) not null,"
+                " origin varchar(50) not null default '',"
+                " logged_datetime datetime not null default current_timestamp"
+                ")"
+             << "create index change_log_origin_seq on change_log(origin, seq)"
+             << "create table sync_state ("
+                " key varchar(100) primary key,"
+                " value text not null default ''"
+                ")"
+             << "insert into sync_state(key, value) values ('origin', '')"
+             << "insert into sync_state(key, value) values ('terminal_id', lower(hex(randomblob(16))))"
+             << "insert into sync_state(key, value) values ('last_exported_seq', '0')"
+             << "create table sync_row_map ("
+                " origin varchar(50) not null,"
+                " table_name varchar(50) not null,"
+                " origin_id integer not null,"
+                " local_id integer not null,"
+                " primary key (origin, table_name, origin_id)"
+                ")"
+             << "create index sync_row_map_local on sync_row_map(table_name, local_id)"
+             << "create index if not exists sales_order_details_parent_id on sales_order_details(parent_id)"
+             << changeLogTriggers("sales_orders")
+             << changeLogTriggers("sales_order_details")
+             << changeLogTriggers("products")
+             // Rows already there are the baseline. Rather than a log entry each, they get a block of sequence
+             // numbers ahead of the log, and SyncEngine::exportBaseline() sends them up to these ids once.
+             << "insert into sync_state(key, value) select 'baseline_max_id:products', coalesce(max(id), 0) from products"
+             << "insert into sync_state(key, value) select 'baseline_max_id:sales_orders', coalesce(max(id), 0) from sales_orders"
+             << "insert into sync_state(key, value)"
+                " select 'baseline_max_id:sales_order_details', coalesce(max(id), 0) from sales_order_details"
+             << "insert into sync_state(key, value) select 'baseline_seq',"
+                " (select count(*) from products) + (select count(*) from sales_orders)"
+                " + (select count(*) from sales_order_details)"
+             << "insert into sqlite_sequence(name, seq) select 'change_log', cast(value as integer) from sync_state where key='baseline_seq'");
+
+    list << (QStringList()
+             << "create index if not exists sales_orders_state on sales_orders(state)"
+             << "create index if not exists sales_orders_open_datetime on sales_orders(open_datetime)"
+             << "create index if not exists sales_orders_grand_total on sales_orders(grand_total)"
+             << "create index if not exists sales_orders_customer_name on sales_orders(customer_name collate nocase)"
+             << "create index if not exists sales_orders_customer_contact on sales_orders(customer_contact collate nocase)"
+             << "create index if not exists sales_orders_customer_address on sales_orders(customer_address collate nocase)");
+
+    list << (QStringList()
+             << "alter table products add column barcode varchar(50) not null default ''"
+             << "alter table products add column cost double not null default 0"
+             << "alter table products add column price double not null default 0"
+             << "create unique index products_barcode on products(barcode) where barcode<>''");
+
+    list << (QStringList()
+             << "create table customers ("
+                " id integer primary key,"
+                " name varchar(100) not null default '',"
+                " contact varchar(100) not null default '',"
+                " address varchar(100) not null default ''"
+                ")"
+             << "create unique index customers_name_contact on customers(name collate nocase, contact)"
+             << "insert into sync_state(key, value)"
+                " select 'customer_backfill_before', coalesce(max(id), 0) + 1 from sales_orders");
+
+    list << (QStringList()
+             << "create index if not exists sales_orders_state_open_datetime on sales_orders(state, open_datetime)");
+
+    list << (QStringList()
+             << "create table stock_movements ("
+                " id integer primary key,"
+                " product_id integer not null,"
+                " quantity integer not null,"
+                " order_id integer,"
+                " created_datetime datetime not null default current_timestamp"
+                ")"
+             << "create index stock_movements_order_product on stock_movements(order_id, product_id)"
+             << "create table stock_balances ("
+                " product_id integer primary key,"
+                " quantity integer not null default 0,"
+                " tracked integer not null default 0"
+                ")"
+             // Movements without an order are receipts or counts; only those make a product's stock tracked.
+             << "create trigger stock_movements_post after insert on stock_movements begin"
+                " insert or ignore into stock_balances(product_id) values (new.product_id);"
+                " update stock_balances set quantity=quantity+new.quantity,"
+                "  tracked=(tracked or new.order_id is null) where product_id=new.product_id;"
+                " end"
+             << "create trigger stock_movements_no_update before update on stock_movements begin"
+                " select raise(abort, 'stock movements are append-only');"
+                " end"
+             << "create trigger stock_movements_no_delete before delete on stock_movements begin"
+                " select raise(abort, 'stock movements are append-only');"
+                " end"
+             << "insert into stock_movements (product_id, quantity, order_id)"
+                " select p.id, -sum(d.quantity), d.parent_id from sales_order_details d"
+                " join sales_orders o on o.id=d.parent_id and o.state<>2"
+                " join products p on p.name=d.name"
+                " group by d.parent_id, p.id having sum(d.quantity)<>0");
+
+    // External content index: line names are stored once, in sales_order_details, and only tokenized here.
+    list << (QStringList()
+             << "create virtual table sales_order_details_fts using fts5("
+                " name, content='sales_order_details', content_rowid='id', prefix='2 3'"
+                ")"
+             << fullTextTriggers()
+             << "insert into sales_order_details_fts(sales_order_details_fts) values ('rebuild')");
+
+    // Ids are never reused, so an archived order or line keeps its id unique even after the newest hot
+    // rows are deleted. SQLite only grants AUTOINCREMENT at creation, so both tables are rebuilt; dropping
+    // the old ones drops their indexes and triggers, which are created again on the new tables.
+    list << (QStringList()
+             << "create table sales_orders_autoincrement ("
+                " id integer primary key autoincrement,"
+                " state integer not null default 0,"
+                " open_datetime datetime not null default current_timestamp,"
+                " grand_total double not null default 0.0,"
+                " revenue double not null default 0.0,"
+                " customer_name varchar(100) not null default '',"
+                " customer_contact varchar(100) not null default '',"
+                " customer_address varchar(100) not null default '',"
+                " lastmod_datetime datetime not null default current_timestamp"
+                ")"
+             << "insert into sales_orders_autoincrement (id, state, open_datetime, grand_total, revenue,"
+                " customer_name, customer_contact, customer_address, lastmod_datetime)"
+                " select id, state, open_datetime, grand_total, revenue,"
+                " customer_name, customer_contact, customer_address, lastmod_datetime from sales_orders"
+             << "drop table sales_orders"
+             << "alter table sales_orders_autoincrement rename to sales_orders"
+             << "create index sales_orders_state on sales_orders(state)"
+             << "create index sales_orders_open_datetime on sales_orders(open_datetime)"
+             << "create index sales_orders_grand_total on sales_orders(grand_total)"
+             << "create index sales_orders_customer_name on sales_orders(customer_name collate nocase)"
+             << "create index sales_orders_customer_contact on sales_orders(customer_contact collate nocase)"
+             << "create index sales_orders_customer_address on sales_orders(customer_address collate nocase)"
+             << "create index sales_orders_state_open_datetime on sales_orders(state, open_datetime)"
+             << changeLogTriggers("sales_orders")
+             << "create table sales_order_details_autoincrement ("
+                " id integer primary key autoincrement,"
+                " parent_id integer,"
+                " name varchar(100),"
+                " quantity integer not null default 0,"
+                " cost double not null default 0,"
+                " price double not null default 0,"
+                " profit double not null default 0"
+                ")"
+             << "insert into sales_order_details_autoincrement (id, parent_id, name, quantity, cost, price, profit)"
+                " select id, parent_id, name, quantity, cost, price, profit from sales_order_details"
+             << "drop table sales_order_details"
+             << "alter table sales_order_details_autoincrement rename to sales_order_details"
+             << "create index sales_order_details_parent_id on sales_order_details(parent_id)"
+             << changeLogTriggers("sales_order_details")
+             << fullTextTriggers());
+
+    list << (QStringList()
+             << Schema::orderSearchIndex("main")
+             << "insert into sales_orders_fts(sales_orders_fts) values ('rebuild')");
+
+    list << (QStringList()
+             << "alter table change_log add column parent_id integer"
+             << "drop trigger sales_order_details_log_insert"
+             << "drop trigger sales_order_details_log_update"
+             << "drop trigger sales_order_details_log_delete"
+             << changeLogTriggers("sales_order_details", "parent_id"));
+
+    // Balances move on every movement, so watchers refresh only the products a commit touched. The fixed
+    // origin keeps these entries out of the sync export, which only sends local edits.
+    list << (QStringList()
+             << "create trigger stock_movements_log after insert on stock_movements begin"
+                " insert into change_log(table_name, row_id, op, origin) values ('stock_balances', new.product_id, 'U', 'stock');"
+                " end");
+
+    // Lines record their product when written, so that renaming a product does not unmatch its old lines.
+    list << (QStringList()
+             << "alter table sales_order_details add column product_id integer"
+             << "update sales_order_details set product_id=(select id from products p where p.name=sales_order_details.name)");
+
+    return list;
+}
+
+}
+
+// The customer fields of the order list, tokenized for word prefix search. The archive carries the same index
+// over its own orders, so the statements are qualified with the database they belong to.
+QStringList Schema::orderSearchIndex(const QString& schema)
+{
+    const QString row("%1.id, %1.customer_name, %1.customer_contact, %1.customer_address");
+    const QString insert("insert into sales_orders_fts(rowid, customer_name, customer_contact, customer_address)"
+                         " values (" + row.arg("new") + ");");
+    const QString remove("insert into sales_orders_fts(sales_orders_fts, rowid, customer_name, customer_contact,"
+                         " customer_address) values ('delete', " + row.arg("old") + ");");
+
+    return QStringList()
+            << "create virtual table if not exists " + schema + ".sales_orders_fts using fts5("
+               " customer_name, customer_contact, customer_address, content='sales_orders', content_rowid='id'"
+               ")"
+            << "create trigger if not exists " + schema + ".sales_orders_fts_insert after insert on sales_orders begin "
+               + insert + " end"
+            << "create trigger if not exists " + schema + ".sales_orders_fts_delete after delete on sales_orders begin "
+               + remove + " end"
+            << "create trigger if not exists " + schema + ".sales_orders_fts_update"
+               " after update of id, customer_name, customer_contact, customer_address on sales_orders begin "
+               + remove + " " + insert + " end";
+}
+
+bool Schema::upgrade(QSqlDatabase db)
+{
+    QSqlQuery q(db);
+    q.exec("pragma user_version");
+    int version = q.next() ? q.value(0).toInt() : 0;
+    q.finish();
+
+    const QList<QStringList> steps = migrations();
+    for (; version < steps.size(); version++) {
+        db.transaction();
+
+        for (const QString& sql: steps.at(version)) {
+            if (!q.exec(sql)) {
+                qWarning() << "Schema upgrade to version" << version + 1 << "failed:" << q.lastError().text();
+                db.rollback();
+                return false;
+            }
+        }
+
+        q.exec(QString("pragma user_version=%1").arg(version + 1));
+
+        if (!db.commit()) {
+            db.rollback();
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,14 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <QSqlDatabase>
+#include <QStringList>
+
+class Schema
+{
+public:
+    static bool upgrade(QSqlDatabase db = QSqlDatabase::database());
+    static QStringList orderSearchIndex(const QString& schema);
+};
+
+#endif // SCHEMA_H
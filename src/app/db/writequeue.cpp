@@ -0,0 +1,129 @@
+#include "writequeue.h"
+#include "preparedquery.h"
+#include "archiver.h"
+
+#include <QSqlQuery>
+#include <QDebug>
+
+namespace {
+
+const char* const ConnectionName = "writer";
+
+// How long the writer keeps collecting requests after the first one arrives.
+const int GroupCommitWindow = 10;
+
+}
+
+WriteQueue* WriteQueue::self = 0;
+
+WriteQueue::WriteQueue(const QString& databaseName, QObject* parent)
+    : QThread(parent)
+    , databaseName(databaseName)
+    , lastTicket(0)
+    , stopping(false)
+{
+    self = this;
+}
+
+WriteQueue::~WriteQueue()
+{
+    stop();
+
+    if (self == this)
+        self = 0;
+}
+
+int WriteQueue::submit(const Job& job)
+{
+    QMutexLocker locker(&mutex);
+
+    Entry entry;
+    entry.ticket = ++lastTicket;
+    entry.job = job;
+    pending.append(entry);
+
+    condition.wakeOne();
+    return entry.ticket;
+}
+
+void WriteQueue::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        condition.wakeOne();
+    }
+
+    wait();
+}
+
+void WriteQueue::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ConnectionName);
+        db.setDatabaseName(databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        db.open();
+
+        forever {
+            QList<Entry> batch;
+            {
+                QMutexLocker locker(&mutex);
+                while (pending.isEmpty() && !stopping)
+                    condition.wait(&mutex);
+
+                if (pending.isEmpty())
+                    break;
+
+                if (!stopping) {
+                    locker.unlock();
+                    msleep(GroupCommitWindow);
+                    locker.relock();
+                }
+
+                batch.swap(pending);
+            }
+
+            commit(db, batch);
+        }
+
+        PreparedQuery::clearCache(ConnectionName);
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(ConnectionName);
+}
+
+void WriteQueue::commit(QSqlDatabase& db, const QList<Entry>& batch)
+{
+    QList<bool> succeeded;
+    QList<QVariantMap> results;
+
+    // SQLite cannot attach inside a transaction, so an archive made since the last batch is picked up here.
+    Archiver::attach(db);
+
+    db.transaction();
+    QSqlQuery q(db);
+
+    // Each request gets its own savepoint so a failing one does not take the rest of the group down.
+    for (const Entry& entry: batch) {
+        QVariantMap result;
+        q.exec("savepoint request");
+        bool ok = entry.job(db, result);
+        if (!ok) {
+            qWarning() << "Write request" << entry.ticket << "failed";
+            q.exec("rollback to savepoint request");
+        }
+        q.exec("release savepoint request");
+
+        succeeded.append(ok);
+        results.append(result);
+    }
+
+    const bool committed = db.commit();
+    if (!committed)
+        db.rollback();
+
+    for (int i = 0; i < batch.size(); i++)
+        emit finished(batch.at(i).ticket, committed && succeeded.at(i), results.at(i));
+}
@@ -0,0 +1,51 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVariantMap>
+#include <QSqlDatabase>
+
+#include <functional>
+
+class WriteQueue : public QThread
+{
+    Q_OBJECT
+public:
+    typedef std::function<bool(QSqlDatabase& db, QVariantMap& result)> Job;
+
+    WriteQueue(const QString& databaseName, QObject* parent = 0);
+    ~WriteQueue();
+
+    static inline WriteQueue* instance() { return self; }
+
+    int submit(const Job& job);
+    void stop();
+
+signals:
+    void finished(int ticket, bool ok, const QVariantMap& result);
+
+protected:
+    void run();
+
+private:
+    struct Entry
+    {
+        int ticket;
+        Job job;
+    };
+
+    void commit(QSqlDatabase& db, const QList<Entry>& batch);
+
+    static WriteQueue* self;
+
+    QString databaseName;
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<Entry> pending;
+    int lastTicket;
+    bool stopping;
+};
+
+#endif // WRITEQUEUE_H
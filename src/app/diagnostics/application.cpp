@@ -0,0 +1,19 @@
+#include "application.h"
+#include "stalldetector.h"
+
+Application::Application(int& argc, char** argv)
+    : QApplication(argc, argv)
+{
+}
+
+bool Application::notify(QObject* receiver, QEvent* event)
+{
+    StallDetector* detector = StallDetector::instance();
+    if (!detector || !detector->isGuiThread())
+        return QApplication::notify(receiver, event);
+
+    const StallDetector::Dispatch dispatch = detector->beginDispatch(receiver, event);
+    const bool result = QApplication::notify(receiver, event);
+    detector->endDispatch(dispatch);
+    return result;
+}
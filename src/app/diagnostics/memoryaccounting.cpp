@@ -0,0 +1,132 @@
+#include "memoryaccounting.h"
+#include "stalldetector.h"
+
+#include <QTimer>
+#include <QDateTime>
+#include <QTextStream>
+#include <QLocale>
+#include <QDebug>
+
+namespace {
+
+// Peaks are only as fine as the sampling; the log gets a line per component at the slower pace.
+const int SampleInterval = 10 * 1000;
+
+}
+
+MemoryAccounting* MemoryAccounting::self = 0;
+
+MemoryAccounting::MemoryAccounting(const QString& logFileName, QObject* parent)
+    : QObject(parent)
+    , sampleTimer(new QTimer(this))
+    , logTimer(new QTimer(this))
+    , log(logFileName)
+{
+    self = this;
+
+    sampleTimer->setInterval(SampleInterval);
+    connect(sampleTimer, SIGNAL(timeout()), SLOT(sample()));
+    connect(logTimer, SIGNAL(timeout()), SLOT(writeLog()));
+}
+
+MemoryAccounting::~MemoryAccounting()
+{
+    stop();
+    self = 0;
+}
+
+void MemoryAccounting::track(QObject* owner, const char* component, const Probe& probe)
+{
+    if (!self)
+        return;
+
+    if (!self->entries.contains(owner))
+        connect(owner, SIGNAL(destroyed(QObject*)), self, SLOT(untrack(QObject*)));
+
+    Entry entry;
+    entry.component = component;
+    entry.probe = probe;
+    self->entries.insert(owner, entry);
+}
+
+void MemoryAccounting::untrack(QObject* owner)
+{
+    entries.remove(owner);
+}
+
+void MemoryAccounting::start(int interval)
+{
+    if (interval <= 0)
+        return;
+
+    if (!log.open(QIODevice::Append | QIODevice::Text))
+        qWarning() << "Memory accounting: cannot open" << log.fileName();
+
+    logTimer->setInterval(interval * 60 * 1000);
+    sampleTimer->start();
+    logTimer->start();
+}
+
+void MemoryAccounting::stop()
+{
+    if (!logTimer->isActive())
+        return;
+
+    sampleTimer->stop();
+    logTimer->stop();
+    writeLog();
+    log.close();
+}
+
+void MemoryAccounting::sample()
+{
+    StallScope scope("MemoryAccounting::sample");
+
+    // Components whose owners are all gone keep their peak and read zero.
+    for (Usage& usage: components) {
+        usage.owners = 0;
+        usage.current = 0;
+    }
+
+    for (QMultiHash<QObject*, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        Usage& usage = components[it->component];
+        usage.component = it->component;
+        usage.owners++;
+        usage.current += it->probe();
+    }
+
+    for (Usage& usage: components)
+        usage.peak = qMax(usage.peak, usage.current);
+}
+
+QList<MemoryAccounting::Usage> MemoryAccounting::usage()
+{
+    sample();
+    return components.values();
+}
+
+void MemoryAccounting::writeLog()
+{
+    if (!log.isOpen())
+        return;
+
+    const QString now = QDateTime::currentDateTime().toString(Qt::ISODate);
+    const QList<Usage> sampled = usage();
+
+    QTextStream out(&log);
+    for (const Usage& usage: sampled) {
+        out << now << " memory " << usage.component << " owners:" << usage.owners
+            << " current:" << usage.current << " peak:" << usage.peak << "\n";
+    }
+    out.flush();
+}
+
+QString MemoryAccounting::formatBytes(qint64 bytes)
+{
+    if (bytes < 1024)
+        return QString("%1 B").arg(bytes);
+    if (bytes < 1024 * 1024)
+        return QString("%1 KB").arg(QLocale().toString(bytes / 1024.0, 'f', 1));
+
+    return QString("%1 MB").arg(QLocale().toString(bytes / (1024.0 * 1024.0), 'f', 1));
+}
@@ -0,0 +1,95 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QObject>
+#include <QMultiHash>
+#include <QMap>
+#include <QVector>
+#include <QList>
+#include <QSet>
+#include <QFile>
+
+#include <functional>
+
+class QTimer;
+
+// Current and peak memory per component. Long-lived owners register probes that estimate what they hold;
+// the probes are sampled on the GUI thread and written to a log, so that a component that keeps growing
+// through a trading day stands out. Sampling must not stall the till, so a probe never walks its owner's
+// rows: owners keep a running count of their row payloads as they change and the probe only adds it up.
+class MemoryAccounting : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<qint64()> Probe;
+
+    struct Usage
+    {
+        inline Usage() : owners(0), current(0), peak(0) {}
+
+        QString component;
+        int owners;
+        qint64 current;
+        qint64 peak;
+    };
+
+    MemoryAccounting(const QString& logFileName, QObject* parent = 0);
+    ~MemoryAccounting();
+
+    static inline MemoryAccounting* instance() { return self; }
+    static QString formatBytes(qint64 bytes);
+
+    // Does nothing when no registry exists, as in the test suites. The probe is dropped with its owner.
+    static void track(QObject* owner, const char* component, const Probe& probe);
+
+    void start(int interval);
+    void stop();
+
+    QList<Usage> usage();
+
+private slots:
+    void untrack(QObject* owner);
+    void sample();
+    void writeLog();
+
+private:
+    struct Entry
+    {
+        const char* component;
+        Probe probe;
+    };
+
+    static MemoryAccounting* self;
+
+    QMultiHash<QObject*, Entry> entries;
+    QMap<QString, Usage> components;
+    QTimer* sampleTimer;
+    QTimer* logTimer;
+    QFile log;
+};
+
+// Heap estimates for the containers the owners hold: storage at its capacity plus string payloads.
+// Implicitly shared data is counted by every holder, so owners that share strings count them once themselves.
+namespace MemoryUsage {
+
+inline qint64 of(const QString& s) { return s.isNull() ? 0 : qint64(sizeof(QArrayData)) + (s.capacity() + 1) * qint64(sizeof(QChar)); }
+
+template<typename T>
+inline qint64 of(const QVector<T>& v) { return qint64(sizeof(QArrayData)) + v.capacity() * qint64(sizeof(T)); }
+
+template<typename T>
+inline qint64 of(const QList<T>& l)
+{
+    const bool indirect = QTypeInfo<T>::isLarge || QTypeInfo<T>::isStatic;
+    return qint64(sizeof(QListData::Data)) + l.size() * qint64(sizeof(void*) + (indirect ? sizeof(T) : 0));
+}
+
+template<typename K, typename V>
+inline qint64 of(const QHash<K, V>& h) { return h.capacity() * qint64(sizeof(void*)) + h.size() * qint64(sizeof(QHashNode<K, V>)); }
+
+template<typename T>
+inline qint64 of(const QSet<T>& s) { return s.capacity() * qint64(sizeof(void*)) + s.size() * qint64(sizeof(QHashNode<T, QHashDummyValue>)); }
+
+}
+
+#endif // MEMORYACCOUNTING_H
@@ -0,0 +1,76 @@
+#include "memoryoverlay.h"
+#include "memoryaccounting.h"
+
+#include <QTimer>
+#include <QEvent>
+
+MemoryOverlay::MemoryOverlay(QWidget* parent)
+    : QLabel(parent)
+    , timer(new QTimer(this))
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setStyleSheet("background-color:rgba(0,0,0,160);color:white;font-family:monospace;padding:4px;");
+    hide();
+
+    timer->setInterval(1000);
+    connect(timer, SIGNAL(timeout()), SLOT(updateText()));
+
+    parent->installEventFilter(this);
+}
+
+void MemoryOverlay::toggle()
+{
+    if (isVisible()) {
+        timer->stop();
+        hide();
+        return;
+    }
+
+    updateText();
+    show();
+    raise();
+    timer->start();
+}
+
+bool MemoryOverlay::eventFilter(QObject* object, QEvent* event)
+{
+    if (object == parent() && event->type() == QEvent::Resize && isVisible())
+        reposition();
+
+    return QLabel::eventFilter(object, event);
+}
+
+void MemoryOverlay::reposition()
+{
+    // Bottom right, out of the way of the stall overlay.
+    adjustSize();
+    move(parentWidget()->width() - width() - 8, parentWidget()->height() - height() - 8);
+}
+
+void MemoryOverlay::updateText()
+{
+    MemoryAccounting* accounting = MemoryAccounting::instance();
+    if (!accounting) {
+        setText("Pencatat memori tidak aktif");
+        reposition();
+        return;
+    }
+
+    QStringList lines;
+    lines.append(QString("%1 %2 %3 %4").arg("Komponen", -32).arg("Jml", 4).arg("Sekarang", 10).arg("Puncak", 10));
+
+    qint64 current = 0;
+    for (const MemoryAccounting::Usage& usage: accounting->usage()) {
+        lines.append(QString("%1 %2 %3 %4")
+                     .arg(usage.component, -32)
+                     .arg(usage.owners, 4)
+                     .arg(MemoryAccounting::formatBytes(usage.current), 10)
+                     .arg(MemoryAccounting::formatBytes(usage.peak), 10));
+        current += usage.current;
+    }
+
+    lines.append(QString("%1 %2 %3").arg("Total", -32).arg("", 4).arg(MemoryAccounting::formatBytes(current), 10));
+
+    setText(lines.join("\n"));
+    reposition();
+}
@@ -0,0 +1,29 @@
+#ifndef MEMORYOVERLAY_H
+#define MEMORYOVERLAY_H
+
+#include <QLabel>
+
+class QTimer;
+
+class MemoryOverlay : public QLabel
+{
+    Q_OBJECT
+public:
+    MemoryOverlay(QWidget* parent);
+
+public slots:
+    void toggle();
+
+protected:
+    bool eventFilter(QObject* object, QEvent* event);
+
+private slots:
+    void updateText();
+
+private:
+    void reposition();
+
+    QTimer* timer;
+};
+
+#endif // MEMORYOVERLAY_H
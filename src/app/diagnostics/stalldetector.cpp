@@ -0,0 +1,263 @@
+#include "stalldetector.h"
+
+#include <QTimer>
+#include <QEvent>
+#include <QMetaEnum>
+#include <QDateTime>
+#include <QTextStream>
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace {
+
+const int HeartbeatInterval = 50;
+const int WatchdogInterval = 25;
+const int HistogramLogInterval = 10 * 60 * 1000;
+const int MaxDepth = 32;
+
+// Upper bounds of the lag histogram buckets, in milliseconds; the last bucket is open-ended.
+const int BucketLimits[] = { 16, 33, 50, 100, 200, 500, 1000 };
+const int BucketCount = sizeof(BucketLimits) / sizeof(BucketLimits[0]) + 1;
+
+}
+
+class StallDetector::Watchdog : public QThread
+{
+public:
+    Watchdog(StallDetector* detector)
+        : detector(detector)
+    {
+    }
+
+protected:
+    void run()
+    {
+        while (!isInterruptionRequested()) {
+            msleep(WatchdogInterval);
+            detector->checkHeartbeat();
+        }
+    }
+
+private:
+    StallDetector* detector;
+};
+
+StallDetector* StallDetector::self = 0;
+
+StallDetector::StallDetector(const QString& logFileName, QObject* parent)
+    : QObject(parent)
+    , guiThread(QThread::currentThread())
+    , watchdog(new Watchdog(this))
+    , heartbeatTimer(new QTimer(this))
+    , histogramTimer(new QTimer(this))
+    , threshold(200)
+    , log(logFileName)
+    , buckets(BucketCount)
+    , stalls(0)
+    , longestLag(0)
+    , watchdogHeartbeat(-1)
+{
+    self = this;
+    clock.start();
+
+    heartbeatTimer->setInterval(HeartbeatInterval);
+    heartbeatTimer->setTimerType(Qt::PreciseTimer);
+    histogramTimer->setInterval(HistogramLogInterval);
+
+    connect(heartbeatTimer, SIGNAL(timeout()), SLOT(heartbeat()));
+    connect(histogramTimer, SIGNAL(timeout()), SLOT(writeHistogram()));
+}
+
+StallDetector::~StallDetector()
+{
+    stop();
+    delete watchdog;
+    self = 0;
+}
+
+void StallDetector::start(int pThreshold)
+{
+    threshold = pThreshold;
+    if (threshold <= 0)
+        return;
+
+    if (!log.open(QIODevice::Append | QIODevice::Text))
+        qWarning() << "Stall detector: cannot open" << log.fileName();
+
+    lastHeartbeat = clock.elapsed();
+    heartbeatTimer->start();
+    histogramTimer->start();
+    watchdog->start(QThread::HighPriority);
+}
+
+void StallDetector::stop()
+{
+    if (!watchdog->isRunning())
+        return;
+
+    watchdog->requestInterruption();
+    watchdog->wait();
+    heartbeatTimer->stop();
+    histogramTimer->stop();
+    writeHistogram();
+    log.close();
+}
+
+StallDetector::Dispatch StallDetector::beginDispatch(QObject* receiver, QEvent* event)
+{
+    const int d = depth.load();
+    if (d < MaxDepth) {
+        frames[d].className = receiver->metaObject()->className();
+        frames[d].eventType = event->type();
+    }
+    depth.store(d + 1);
+
+    Dispatch dispatch;
+    dispatch.start = clock.elapsed();
+    dispatch.heartbeats = heartbeats.load();
+    return dispatch;
+}
+
+void StallDetector::endDispatch(const Dispatch& dispatch)
+{
+    const qint64 duration = clock.elapsed() - dispatch.start;
+
+    // A nested event loop (a dialog, say) keeps beating, so only dispatches with no heartbeat inside them
+    // stalled. The innermost one reports, and the enclosing dispatches see that it already did.
+    if (duration >= threshold && threshold > 0 && heartbeats.load() == dispatch.heartbeats
+            && reportedHeartbeat.load() != dispatch.heartbeats + 1) {
+        reportedHeartbeat.store(dispatch.heartbeats + 1);
+        report("stall", duration, currentLabel());
+    }
+
+    depth.store(depth.load() - 1);
+}
+
+void StallDetector::pushScope(const char* label)
+{
+    const int d = scopeDepth.load();
+    if (d < MaxDepth)
+        scopes[d] = label;
+    scopeDepth.store(d + 1);
+}
+
+void StallDetector::popScope()
+{
+    scopeDepth.store(scopeDepth.load() - 1);
+}
+
+QString StallDetector::currentLabel() const
+{
+    QString label;
+
+    const int s = qMin(scopeDepth.load(), MaxDepth);
+    if (s > 0)
+        label = scopes[s - 1];
+
+    const int d = qMin(depth.load(), MaxDepth);
+    if (d > 0) {
+        const Frame frame = frames[d - 1];
+        const QMetaEnum types = QEvent::staticMetaObject.enumerator(QEvent::staticMetaObject.indexOfEnumerator("Type"));
+        const char* type = types.valueToKey(frame.eventType);
+        const QString event = QString("%1 %2").arg(frame.className, type ? QString(type) : QString::number(frame.eventType));
+        label = label.isEmpty() ? event : label + " (" + event + ")";
+    }
+
+    return label.isEmpty() ? QString("idle") : label;
+}
+
+void StallDetector::heartbeat()
+{
+    const qint64 now = clock.elapsed();
+    const int lag = qMax<qint64>(0, now - lastHeartbeat.load() - HeartbeatInterval);
+    lastHeartbeat.store(now);
+    heartbeats.ref();
+
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && lag > BucketLimits[bucket])
+        bucket++;
+
+    QMutexLocker locker(&mutex);
+    buckets[bucket]++;
+    longestLag = qMax(longestLag, lag);
+}
+
+void StallDetector::checkHeartbeat()
+{
+    // Runs on the watchdog thread, so that a hang is on record even if the GUI never recovers.
+    const int beat = heartbeats.load();
+    const qint64 gap = clock.elapsed() - lastHeartbeat.load();
+    if (gap < threshold + HeartbeatInterval || watchdogHeartbeat == beat)
+        return;
+
+    watchdogHeartbeat = beat;
+    report("stalling", gap - HeartbeatInterval, currentLabel());
+}
+
+void StallDetector::report(const QString& kind, qint64 duration, const QString& label)
+{
+    QMutexLocker locker(&mutex);
+
+    // The watchdog's in-progress notice is logged only; the stall is counted once the GUI thread returns.
+    const bool finished = kind == "stall";
+    if (finished) {
+        stalls++;
+        lastStallLabel = label;
+    }
+
+    if (log.isOpen()) {
+        QTextStream out(&log);
+        out << QDateTime::currentDateTime().toString(Qt::ISODate) << " " << kind << " "
+            << duration << " ms in " << label << "\n";
+        out.flush();
+    }
+
+    locker.unlock();
+
+    if (finished)
+        QMetaObject::invokeMethod(this, "stalled", Qt::QueuedConnection,
+                                  Q_ARG(int, int(duration)), Q_ARG(QString, label));
+}
+
+void StallDetector::writeHistogram()
+{
+    QMutexLocker locker(&mutex);
+    if (!log.isOpen())
+        return;
+
+    QTextStream out(&log);
+    out << QDateTime::currentDateTime().toString(Qt::ISODate) << " lag histogram";
+    for (int i = 0; i < BucketCount; i++)
+        out << " " << bucketLabel(i) << ":" << buckets.at(i);
+    out << " max:" << longestLag << " ms stalls:" << stalls << "\n";
+    out.flush();
+}
+
+QString StallDetector::bucketLabel(int bucket)
+{
+    return bucket < BucketCount - 1 ? QString("<=%1").arg(BucketLimits[bucket]) : QString(">%1").arg(BucketLimits[BucketCount - 2]);
+}
+
+QVector<int> StallDetector::histogram() const
+{
+    QMutexLocker locker(&mutex);
+    return buckets;
+}
+
+int StallDetector::stallCount() const
+{
+    QMutexLocker locker(&mutex);
+    return stalls;
+}
+
+int StallDetector::maxLag() const
+{
+    QMutexLocker locker(&mutex);
+    return longestLag;
+}
+
+QString StallDetector::lastStall() const
+{
+    QMutexLocker locker(&mutex);
+    return lastStallLabel;
+}
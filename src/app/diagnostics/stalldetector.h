@@ -0,0 +1,116 @@
+#ifndef STALLDETECTOR_H
+#define STALLDETECTOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QVector>
+#include <QFile>
+#include <QThread>
+
+class QTimer;
+class QEvent;
+
+// Measures GUI event loop lag with heartbeats and attributes stalls to the event or slot that was running.
+class StallDetector : public QObject
+{
+    Q_OBJECT
+public:
+    struct Dispatch
+    {
+        qint64 start;
+        int heartbeats;
+    };
+
+    StallDetector(const QString& logFileName, QObject* parent = 0);
+    ~StallDetector();
+
+    static inline StallDetector* instance() { return self; }
+    static QString bucketLabel(int bucket);
+
+    void start(int threshold);
+    void stop();
+
+    inline bool isGuiThread() const { return QThread::currentThread() == guiThread; }
+
+    Dispatch beginDispatch(QObject* receiver, QEvent* event);
+    void endDispatch(const Dispatch& dispatch);
+
+    void pushScope(const char* label);
+    void popScope();
+
+    QVector<int> histogram() const;
+    int stallCount() const;
+    int maxLag() const;
+    QString lastStall() const;
+
+signals:
+    void stalled(int duration, const QString& label);
+
+private slots:
+    void heartbeat();
+    void writeHistogram();
+
+private:
+    class Watchdog;
+
+    struct Frame
+    {
+        const char* className;
+        int eventType;
+    };
+
+    QString currentLabel() const;
+    void report(const QString& kind, qint64 duration, const QString& label);
+    void checkHeartbeat();
+
+    static StallDetector* self;
+
+    QThread* guiThread;
+    Watchdog* watchdog;
+    QTimer* heartbeatTimer;
+    QTimer* histogramTimer;
+    QElapsedTimer clock;
+    int threshold;
+
+    // Written by the GUI thread, read racily by the watchdog; both only point at static strings.
+    Frame frames[32];
+    QAtomicInt depth;
+    const char* scopes[32];
+    QAtomicInt scopeDepth;
+    QAtomicInteger<qint64> lastHeartbeat;
+    QAtomicInt heartbeats;
+    QAtomicInt reportedHeartbeat;
+    int watchdogHeartbeat;
+
+    mutable QMutex mutex;
+    QFile log;
+    QVector<int> buckets;
+    int stalls;
+    int longestLag;
+    QString lastStallLabel;
+};
+
+// Names the code running on the GUI thread so that a stall inside it is reported by name.
+class StallScope
+{
+public:
+    inline StallScope(const char* label)
+    {
+        if (StallDetector::instance())
+            StallDetector::instance()->pushScope(label);
+    }
+
+    inline ~StallScope()
+    {
+        if (StallDetector::instance())
+            StallDetector::instance()->popScope();
+    }
+
+private:
+    Q_DISABLE_COPY(StallScope)
+};
+
+#endif // STALLDETECTOR_H
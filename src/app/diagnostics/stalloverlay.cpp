@@ -0,0 +1,68 @@
+#include "stalloverlay.h"
+#include "stalldetector.h"
+
+#include <QTimer>
+#include <QEvent>
+
+StallOverlay::StallOverlay(QWidget* parent)
+    : QLabel(parent)
+    , timer(new QTimer(this))
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setStyleSheet("background-color:rgba(0,0,0,160);color:white;font-family:monospace;padding:4px;");
+    hide();
+
+    timer->setInterval(500);
+    connect(timer, SIGNAL(timeout()), SLOT(updateText()));
+
+    parent->installEventFilter(this);
+}
+
+void StallOverlay::toggle()
+{
+    if (isVisible()) {
+        timer->stop();
+        hide();
+        return;
+    }
+
+    updateText();
+    show();
+    raise();
+    timer->start();
+}
+
+bool StallOverlay::eventFilter(QObject* object, QEvent* event)
+{
+    if (object == parent() && event->type() == QEvent::Resize && isVisible())
+        reposition();
+
+    return QLabel::eventFilter(object, event);
+}
+
+void StallOverlay::reposition()
+{
+    adjustSize();
+    move(parentWidget()->width() - width() - 8, 8);
+}
+
+void StallOverlay::updateText()
+{
+    const StallDetector* detector = StallDetector::instance();
+    if (!detector) {
+        setText("Detektor stall tidak aktif");
+        reposition();
+        return;
+    }
+
+    const QVector<int> histogram = detector->histogram();
+    QStringList lines;
+    lines.append(QString("Lag maks: %1 ms, stall: %2").arg(detector->maxLag()).arg(detector->stallCount()));
+    if (!detector->lastStall().isEmpty())
+        lines.append("Terakhir: " + detector->lastStall());
+    for (int i = 0; i < histogram.size(); i++)
+        lines.append(QString("%1 ms: %2").arg(StallDetector::bucketLabel(i), -6).arg(histogram.at(i)));
+
+    setText(lines.join("\n"));
+    reposition();
+}
@@ -0,0 +1,29 @@
+#ifndef STALLOVERLAY_H
+#define STALLOVERLAY_H
+
+#include <QLabel>
+
+class QTimer;
+
+class StallOverlay : public QLabel
+{
+    Q_OBJECT
+public:
+    StallOverlay(QWidget* parent);
+
+public slots:
+    void toggle();
+
+protected:
+    bool eventFilter(QObject* object, QEvent* event);
+
+private slots:
+    void updateText();
+
+private:
+    void reposition();
+
+    QTimer* timer;
+};
+
+#endif // STALLOVERLAY_H
@@ -1,31 +1,69 @@
 #include "mainwindow.h"
 #include "sales/salesordereditorproductmodel.h"
+#include "db/schema.h"
+#include "db/writequeue.h"
+#include "db/preparedquery.h"
+#include "products/productcatalog.h"
+#include "customers/customerdirectory.h"
+#include "diagnostics/application.h"
+#include "diagnostics/stalldetector.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include <QTimer>
-#include <QApplication>
+#include <QSettings>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 
 int main(int argc, char** argv)
 {
-    QApplication app(argc, argv);
+    Application app(argc, argv);
     app.setApplicationDisplayName("Bilzia Point of Sales");
+    app.setOrganizationName("Bilzia");
+    app.setApplicationName("bilzia-pos");
 
     QLocale::setDefault(QLocale(QLocale::Indonesian, QLocale::Indonesia));
 
     {
         QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
         db.setDatabaseName("bilzia-pos.sqlite3");
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
         db.open();
+        QSqlQuery(db).exec("pragma journal_mode=wal");
+        Schema::upgrade(db);
     }
 
+    WriteQueue writeQueue(QSqlDatabase::database().databaseName());
+    writeQueue.start();
+
+    QSettings settings;
+
+    // Created before the long-lived owners so that they can register with it.
+    MemoryAccounting memoryAccounting(settings.value("diagnostics/memoryLog", "bilzia-pos-memory.log").toString());
+
+    ProductCatalog* productCatalog = new ProductCatalog(&app);
+    productCatalog->reload();
+    new SalesOrderEditor::ProductModel(&app);
+
+    CustomerDirectory* customerDirectory = new CustomerDirectory(&app);
+    customerDirectory->reload();
+    QTimer::singleShot(0, customerDirectory, SLOT(backfill()));
+
+    StallDetector stallDetector(settings.value("diagnostics/log", "bilzia-pos-stalls.log").toString());
+    stallDetector.start(settings.value("diagnostics/stallThreshold", 200).toInt());
+    memoryAccounting.start(settings.value("diagnostics/memoryLogInterval", 10).toInt());
+
     MainWindow mainWindow;
 
     QTimer::singleShot(0, &mainWindow, SLOT(showMaximized()));
-    QTimer::singleShot(0, new SalesOrderEditor::ProductModel(&app), SLOT(refresh()));
 
     int exitCode = app.exec();
 
+    memoryAccounting.stop();
+    stallDetector.stop();
+    writeQueue.stop();
+
     {
+        PreparedQuery::clearCache();
         QSqlDatabase::database(QSqlDatabase::defaultConnection).close();
         QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
     }
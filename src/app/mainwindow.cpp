@@ -1,8 +1,59 @@
 #include "mainwindow.h"
 #include "sales/salesordermanager.h"
+#include "db/archiver.h"
+#include "db/backup.h"
+#include "db/changewatcher.h"
+#include "products/productcatalog.h"
+#include "diagnostics/stalloverlay.h"
+#ifdef DIAGNOSTICS_BUILD
+#include "diagnostics/memoryoverlay.h"
+#endif
+#include "sync/syncengine.h"
+#include "sync/synchub.h"
+
+#include <QSettings>
+#include <QSqlDatabase>
+#include <QAction>
 
 MainWindow::MainWindow()
+    : syncEngine(0)
 {
     salesOrderManager = new SalesOrderManager(this);
     setCentralWidget(salesOrderManager);
+
+    QSettings settings;
+    const QString hubPath = settings.value("sync/hub").toString();
+    if (!hubPath.isEmpty()) {
+        syncEngine = new SyncEngine(QSqlDatabase::database().databaseName(), new DirectorySyncHub(hubPath), this);
+        connect(syncEngine, SIGNAL(imported(QList<qlonglong>)), salesOrderManager, SLOT(invalidate(QList<qlonglong>)));
+        syncEngine->start(settings.value("sync/interval", 60).toInt() * 1000);
+    }
+
+    archiver = new Archiver(this);
+    archiver->start(settings.value("archive/days", 90).toInt());
+
+    backup = new Backup(QSqlDatabase::database().databaseName(), this);
+    backup->start(settings.value("backup/interval", 60).toInt(), settings.value("backup/generations", 24).toInt(),
+                  settings.value("backup/directory").toString());
+
+    changeWatcher = new ChangeWatcher(this);
+    connect(changeWatcher, SIGNAL(ordersChanged(QList<qlonglong>)), salesOrderManager, SLOT(invalidate(QList<qlonglong>)));
+    connect(changeWatcher, SIGNAL(productsChanged(QList<qlonglong>)), ProductCatalog::instance(), SLOT(refresh(QList<qlonglong>)));
+    connect(changeWatcher, SIGNAL(changed()), ProductCatalog::instance(), SLOT(reloadStock()));
+    connect(changeWatcher, SIGNAL(stockChanged(QList<qlonglong>)), ProductCatalog::instance(), SLOT(refreshStock(QList<qlonglong>)));
+    changeWatcher->start(settings.value("watch/interval", 1000).toInt());
+
+    stallOverlay = new StallOverlay(this);
+    QAction* stallOverlayAction = new QAction(this);
+    stallOverlayAction->setShortcut(QKeySequence("Ctrl+Shift+F12"));
+    addAction(stallOverlayAction);
+    connect(stallOverlayAction, SIGNAL(triggered(bool)), stallOverlay, SLOT(toggle()));
+
+#ifdef DIAGNOSTICS_BUILD
+    memoryOverlay = new MemoryOverlay(this);
+    QAction* memoryOverlayAction = new QAction(this);
+    memoryOverlayAction->setShortcut(QKeySequence("Ctrl+Shift+F11"));
+    addAction(memoryOverlayAction);
+    connect(memoryOverlayAction, SIGNAL(triggered(bool)), memoryOverlay, SLOT(toggle()));
+#endif
 }
@@ -4,6 +4,14 @@
 #include <QMainWindow>
 
 class SalesOrderManager;
+class SyncEngine;
+class Archiver;
+class Backup;
+class ChangeWatcher;
+class StallOverlay;
+#ifdef DIAGNOSTICS_BUILD
+class MemoryOverlay;
+#endif
 
 class MainWindow : public QMainWindow
 {
@@ -13,6 +21,14 @@ public:
 
 private:
     SalesOrderManager* salesOrderManager;
+    SyncEngine* syncEngine;
+    Archiver* archiver;
+    Backup* backup;
+    ChangeWatcher* changeWatcher;
+    StallOverlay* stallOverlay;
+#ifdef DIAGNOSTICS_BUILD
+    MemoryOverlay* memoryOverlay;
+#endif
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,203 @@
+#include "productcatalog.h"
+#include "db/preparedquery.h"
+#include "diagnostics/memoryaccounting.h"
+
+#include <QVariantMap>
+
+#define SELECT_PRODUCT_COLUMNS \
+    "select p.id, p.name, p.barcode, p.cost, p.price, coalesce(b.quantity, 0), coalesce(b.tracked, 0)" \
+    " from products p left join stock_balances b on b.product_id=p.id"
+
+ProductCatalog* ProductCatalog::self = 0;
+
+ProductCatalog::ProductCatalog(QObject* parent)
+    : QObject(parent)
+    , indexedBytes(0)
+{
+    self = this;
+
+    MemoryAccounting::track(this, "ProductCatalog", [this]() -> qint64 {
+        return MemoryUsage::of(products) + MemoryUsage::of(indexById) + MemoryUsage::of(indexByBarcode)
+                + MemoryUsage::of(indexByName) + indexedBytes;
+    });
+}
+
+QString ProductCatalog::normalize(const QString& name)
+{
+    return name.simplified().toCaseFolded();
+}
+
+int ProductCatalog::indexOfBarcode(const QString& barcode) const
+{
+    return barcode.isEmpty() ? -1 : indexByBarcode.value(barcode, -1);
+}
+
+int ProductCatalog::indexOfName(const QString& name) const
+{
+    return indexByName.value(normalize(name), -1);
+}
+
+int ProductCatalog::find(const QString& text) const
+{
+    const int i = indexOfBarcode(text.trimmed());
+    return i >= 0 ? i : indexOfName(text);
+}
+
+void ProductCatalog::reload()
+{
+    products.clear();
+    indexById.clear();
+    indexByBarcode.clear();
+    indexByName.clear();
+    indexedBytes = 0;
+
+    PreparedQuery q(SELECT_PRODUCT_COLUMNS);
+    q->exec();
+    while (q->next()) {
+        products.append(readProduct(*q));
+        index(products.size() - 1);
+    }
+
+    emit reloaded();
+}
+
+ProductCatalog::Product ProductCatalog::readProduct(const QSqlQuery& q)
+{
+    Product product;
+    product.id = q.value(0).toLongLong();
+    product.name = q.value(1).toString();
+    product.barcode = q.value(2).toString();
+    product.cost = q.value(3).toDouble();
+    product.price = q.value(4).toDouble();
+    product.stock = q.value(5).toInt();
+    product.stockTracked = q.value(6).toBool();
+    return product;
+}
+
+void ProductCatalog::updateStock(const QVariantList& balances)
+{
+    for (const QVariant& value: balances) {
+        const QVariantMap balance = value.toMap();
+        const int i = indexById.value(balance.value("productId").toLongLong(), -1);
+        if (i < 0)
+            continue;
+
+        Product& product = products[i];
+        product.stock = balance.value("quantity").toInt();
+        product.stockTracked = balance.value("tracked").toBool();
+        emit productChanged(i);
+    }
+}
+
+void ProductCatalog::reloadStock()
+{
+    PreparedQuery q("select product_id, quantity, tracked from stock_balances");
+    q->exec();
+    while (q->next()) {
+        const int i = indexById.value(q->value(0).toLongLong(), -1);
+        if (i < 0)
+            continue;
+
+        Product& product = products[i];
+        const int stock = q->value(1).toInt();
+        const bool tracked = q->value(2).toBool();
+        if (product.stock == stock && product.stockTracked == tracked)
+            continue;
+
+        product.stock = stock;
+        product.stockTracked = tracked;
+        emit productChanged(i);
+    }
+}
+
+void ProductCatalog::refreshStock(const QList<qlonglong>& productIds)
+{
+    for (qlonglong id: productIds) {
+        const int i = indexById.value(id, -1);
+        if (i < 0)
+            continue;
+
+        PreparedQuery q("select quantity, tracked from stock_balances where product_id=?");
+        q->bindValue(0, id);
+        q->exec();
+        if (!q->next())
+            continue;
+
+        Product& product = products[i];
+        const int stock = q->value(0).toInt();
+        const bool tracked = q->value(1).toBool();
+        if (product.stock == stock && product.stockTracked == tracked)
+            continue;
+
+        product.stock = stock;
+        product.stockTracked = tracked;
+        emit productChanged(i);
+    }
+}
+
+void ProductCatalog::refresh(const QList<qlonglong>& ids)
+{
+    int found = 0;
+
+    for (qlonglong id: ids) {
+        PreparedQuery q(SELECT_PRODUCT_COLUMNS " where p.id=?");
+        q->bindValue(0, id);
+        q->exec();
+        if (!q->next())
+            continue;
+
+        update(readProduct(*q));
+        found++;
+    }
+
+    // Deleted products leave holes in the index, which only a full reload repairs.
+    if (found < ids.size())
+        reload();
+}
+
+void ProductCatalog::update(const Product& product)
+{
+    int i = indexById.value(product.id, -1);
+    if (i >= 0) {
+        unindex(i);
+        products[i] = product;
+        index(i);
+        emit productChanged(i);
+        return;
+    }
+
+    products.append(product);
+    i = products.size() - 1;
+    index(i);
+    emit productAdded(i);
+}
+
+void ProductCatalog::index(int i)
+{
+    const Product& product = products.at(i);
+    const QString nameKey = normalize(product.name);
+    indexById.insert(product.id, i);
+    indexByName.insert(nameKey, i);
+    if (!product.barcode.isEmpty())
+        indexByBarcode.insert(product.barcode, i);
+
+    indexedBytes += payload(product, nameKey);
+}
+
+void ProductCatalog::unindex(int i)
+{
+    const Product& product = products.at(i);
+    const QString nameKey = normalize(product.name);
+    indexById.remove(product.id);
+    indexByName.remove(nameKey);
+    if (!product.barcode.isEmpty())
+        indexByBarcode.remove(product.barcode);
+
+    indexedBytes -= payload(product, nameKey);
+}
+
+// Barcode keys share their strings with the products; normalized names are copies.
+qint64 ProductCatalog::payload(const Product& product, const QString& nameKey)
+{
+    return MemoryUsage::of(product.name) + MemoryUsage::of(product.barcode) + MemoryUsage::of(nameKey);
+}
@@ -0,0 +1,78 @@
+#ifndef PRODUCTCATALOG_H
+#define PRODUCTCATALOG_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QVariantList>
+
+class QSqlQuery;
+
+class ProductCatalog : public QObject
+{
+    Q_OBJECT
+public:
+    struct Product
+    {
+        inline Product()
+            : id(0)
+            , cost(0.0)
+            , price(0.0)
+            , stock(0)
+            , stockTracked(false)
+        {}
+
+        qlonglong id;
+        QString name;
+        QString barcode;
+        double cost;
+        double price;
+        int stock;
+        bool stockTracked;
+    };
+
+    ProductCatalog(QObject* parent);
+
+    static inline ProductCatalog* instance() { return self; }
+    static QString normalize(const QString& name);
+
+    inline int count() const { return products.size(); }
+    inline const Product& at(int index) const { return products.at(index); }
+
+    int indexOfBarcode(const QString& barcode) const;
+    int indexOfName(const QString& name) const;
+    int find(const QString& text) const;
+
+    void update(const Product& product);
+    void updateStock(const QVariantList& balances);
+
+signals:
+    void productAdded(int index);
+    void productChanged(int index);
+    void reloaded();
+
+public slots:
+    void reload();
+    void refresh(const QList<qlonglong>& ids);
+    void reloadStock();
+    void refreshStock(const QList<qlonglong>& productIds);
+
+private:
+    static Product readProduct(const QSqlQuery& q);
+
+    void index(int i);
+    void unindex(int i);
+    static qint64 payload(const Product& product, const QString& nameKey);
+
+    static ProductCatalog* self;
+
+    QVector<Product> products;
+    QHash<qlonglong, int> indexById;
+    QHash<QString, int> indexByBarcode;
+    QHash<QString, int> indexByName;
+
+    // String bytes of the indexed products and their name keys, so that accounting never walks the catalog.
+    qint64 indexedBytes;
+};
+
+#endif // PRODUCTCATALOG_H
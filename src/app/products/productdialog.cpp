@@ -0,0 +1,120 @@
+#include "productdialog.h"
+#include "db/writequeue.h"
+#include "db/preparedquery.h"
+
+#include <QLineEdit>
+#include <QLabel>
+#include <QFormLayout>
+#include <QBoxLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+#include <QLocale>
+
+ProductDialog::ProductDialog(const ProductCatalog::Product& product, QWidget* parent)
+    : QDialog(parent)
+    , product(product)
+    , saveTicket(0)
+{
+    setWindowTitle("Produk");
+
+    QLineEdit* nameEdit = new QLineEdit(product.name, this);
+    nameEdit->setReadOnly(true);
+
+    barcodeEdit = new QLineEdit(product.barcode, this);
+    barcodeEdit->setMaxLength(50);
+    barcodeEdit->setPlaceholderText("Pindai atau ketik barcode");
+
+    QLocale locale;
+    costEdit = new QLineEdit(locale.toString(product.cost, 'f', 0), this);
+    costEdit->setAlignment(Qt::AlignRight);
+    priceEdit = new QLineEdit(locale.toString(product.price, 'f', 0), this);
+    priceEdit->setAlignment(Qt::AlignRight);
+
+    infoLabel = new QLabel(this);
+
+    QFormLayout* form = new QFormLayout;
+    form->addRow("Nama Produk", nameEdit);
+    form->addRow("&Barcode", barcodeEdit);
+    form->addRow("&Modal", costEdit);
+    form->addRow("&Harga", priceEdit);
+
+    // Scanners finish a code with Enter, which must not save the product before cost and price are checked.
+    QPushButton* saveButton = new QPushButton(QIcon(":/resources/icons/ok.png"), "&Simpan", this);
+    saveButton->setAutoDefault(false);
+    QPushButton* cancelButton = new QPushButton(QIcon(":/resources/icons/close.png"), "&Batal", this);
+    cancelButton->setAutoDefault(false);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(this);
+    buttons->addButton(saveButton, QDialogButtonBox::AcceptRole);
+    buttons->addButton(cancelButton, QDialogButtonBox::RejectRole);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(infoLabel);
+    layout->addWidget(buttons);
+
+    connect(buttons, SIGNAL(accepted()), SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), SLOT(reject()));
+    connect(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)), SLOT(onWriteFinished(int,bool,QVariantMap)));
+
+    barcodeEdit->setFocus();
+}
+
+void ProductDialog::accept()
+{
+    if (saveTicket)
+        return;
+
+    QLocale locale;
+    bool costOk = false;
+    bool priceOk = false;
+    pending = product;
+    pending.barcode = barcodeEdit->text().trimmed();
+    pending.cost = locale.toDouble(costEdit->text(), &costOk);
+    pending.price = locale.toDouble(priceEdit->text(), &priceOk);
+
+    if (!costOk || !priceOk) {
+        infoLabel->setText("Modal dan harga harus berupa angka.");
+        return;
+    }
+
+    const ProductCatalog* catalog = ProductCatalog::instance();
+    const int other = catalog->indexOfBarcode(pending.barcode);
+    if (other >= 0 && catalog->at(other).id != product.id) {
+        infoLabel->setText(QString("Barcode sudah dipakai untuk <b>%1</b>.").arg(catalog->at(other).name.toHtmlEscaped()));
+        barcodeEdit->selectAll();
+        barcodeEdit->setFocus();
+        return;
+    }
+
+    const ProductCatalog::Product changed = pending;
+    saveTicket = WriteQueue::instance()->submit([changed](QSqlDatabase& db, QVariantMap&) {
+        PreparedQuery q("update products set barcode=?, cost=?, price=? where id=?", db);
+        q->bindValue(0, changed.barcode);
+        q->bindValue(1, changed.cost);
+        q->bindValue(2, changed.price);
+        q->bindValue(3, changed.id);
+        return q->exec();
+    });
+
+    setEnabled(false);
+    infoLabel->setText("Menyimpan...");
+}
+
+void ProductDialog::onWriteFinished(int ticket, bool ok, const QVariantMap& /*result*/)
+{
+    if (ticket != saveTicket)
+        return;
+
+    saveTicket = 0;
+    setEnabled(true);
+
+    // The unique index also catches a barcode that another terminal has taken in the meantime.
+    if (!ok) {
+        infoLabel->setText("Produk gagal disimpan, barcode mungkin sudah dipakai produk lain.");
+        return;
+    }
+
+    ProductCatalog::instance()->update(pending);
+    QDialog::accept();
+}
@@ -0,0 +1,36 @@
+#ifndef PRODUCTDIALOG_H
+#define PRODUCTDIALOG_H
+
+#include "productcatalog.h"
+
+#include <QDialog>
+#include <QVariantMap>
+
+class QLineEdit;
+class QLabel;
+
+// Edits a catalog product's barcode, cost and price. The change goes through the write queue, and the
+// catalog is updated once it has been committed.
+class ProductDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    ProductDialog(const ProductCatalog::Product& product, QWidget* parent);
+
+public slots:
+    void accept();
+
+private slots:
+    void onWriteFinished(int ticket, bool ok, const QVariantMap& result);
+
+private:
+    ProductCatalog::Product product;
+    ProductCatalog::Product pending;
+    QLineEdit* barcodeEdit;
+    QLineEdit* costEdit;
+    QLineEdit* priceEdit;
+    QLabel* infoLabel;
+    int saveTicket;
+};
+
+#endif // PRODUCTDIALOG_H
@@ -0,0 +1,99 @@
+#ifndef COLUMNSCHEMA_H
+#define COLUMNSCHEMA_H
+
+#include <QVariant>
+#include <QDateTime>
+#include <QLocale>
+
+#include <type_traits>
+
+// Everything a table model needs to know about one column of a typed row. Models keep a static array of
+// these, expanded from a single column list, and index it by column instead of switching on it.
+template<typename Row>
+struct ColumnDescriptor
+{
+    const char* label;
+    int alignment;
+    bool editable;
+    QVariant (*value)(const Row& row);
+    QVariant (*display)(const Row& row);
+    bool hasIntegerSortKey;
+    qint64 (*integerSortKey)(const Row& row);
+};
+
+namespace ColumnSchema {
+
+template<typename T>
+inline QVariant plain(const T& value) { return QVariant::fromValue(value); }
+
+inline QVariant number(const int& value) { return QLocale().toString(value); }
+inline QVariant money(const double& value) { return QLocale().toString(value, 'f', 0); }
+inline QVariant date(const QDateTime& value) { return value.date().toString("dd/MM/yyyy"); }
+
+// Numbers and timestamps sort by a 64-bit key; money keeps its cents.
+inline qint64 integerKey(qlonglong value) { return value; }
+inline qint64 integerKey(int value) { return value; }
+inline qint64 integerKey(double value) { return qRound64(value * 100); }
+inline qint64 integerKey(const QDateTime& value) { return value.toMSecsSinceEpoch(); }
+inline qint64 integerKey(const QString&) { return 0; }
+
+template<typename T>
+struct HasIntegerKey { static const bool value = !std::is_same<T, QString>::value; };
+
+template<typename Row, typename T, T Row::*member>
+QVariant valueOf(const Row& row) { return QVariant::fromValue(row.*member); }
+
+template<typename Row, typename T, T Row::*member, QVariant (*format)(const T&)>
+QVariant displayOf(const Row& row) { return format(row.*member); }
+
+template<typename Row, typename T, T Row::*member>
+qint64 integerKeyOf(const Row& row) { return integerKey(row.*member); }
+
+template<typename Row>
+qint64 noIntegerKey(const Row&) { return 0; }
+
+}
+
+// A column stored in a row member.
+#define MEMBER_COLUMN(Row, member, type, label, alignment, editable, format) \
+    { label, alignment, editable, \
+      &ColumnSchema::valueOf<Row, type, &Row::member>, \
+      &ColumnSchema::displayOf<Row, type, &Row::member, format>, \
+      ColumnSchema::HasIntegerKey<type>::value, \
+      &ColumnSchema::integerKeyOf<Row, type, &Row::member> }
+
+// A column computed from the whole row.
+#define COMPUTED_COLUMN(Row, label, alignment, editable, value, display) \
+    { label, alignment, editable, value, display, false, &ColumnSchema::noIntegerKey<Row> }
+
+// The stored columns of the order tables: name and SQL definition. The archiver copies rows between the hot
+// database and the archive by these lists and creates the archive's tables from them.
+#define SALES_ORDER_TABLE_COLUMNS(FIRST, NEXT) \
+    FIRST(id, "integer primary key") \
+    NEXT(state, "integer not null default 0") \
+    NEXT(open_datetime, "datetime not null default current_timestamp") \
+    NEXT(grand_total, "double not null default 0.0") \
+    NEXT(revenue, "double not null default 0.0") \
+    NEXT(customer_name, "varchar(100) not null default ''") \
+    NEXT(customer_contact, "varchar(100) not null default ''") \
+    NEXT(customer_address, "varchar(100) not null default ''") \
+    NEXT(lastmod_datetime, "datetime not null default current_timestamp")
+
+#define SALES_ORDER_DETAIL_TABLE_COLUMNS(FIRST, NEXT) \
+    FIRST(id, "integer primary key") \
+    NEXT(parent_id, "integer") \
+    NEXT(name, "varchar(100)") \
+    NEXT(quantity, "integer not null default 0") \
+    NEXT(cost, "double not null default 0") \
+    NEXT(price, "double not null default 0") \
+    NEXT(profit, "double not null default 0") \
+    NEXT(product_id, "integer")
+
+#define TABLE_COLUMN_NAME_FIRST(column, definition) #column
+#define TABLE_COLUMN_NAME_NEXT(column, definition) ", " #column
+#define TABLE_COLUMN_DEFINITION_FIRST(column, definition) #column " " definition
+#define TABLE_COLUMN_DEFINITION_NEXT(column, definition) ", " #column " " definition
+// Leaves the id out, for a statement that supplies it itself.
+#define TABLE_COLUMN_SKIP(column, definition)
+
+#endif // COLUMNSCHEMA_H
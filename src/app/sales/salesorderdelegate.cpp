@@ -0,0 +1,137 @@
+#include "salesorderdelegate.h"
+
+#include <QPainter>
+#include <QApplication>
+#include <QFontMetrics>
+#include <QStyleOption>
+
+namespace {
+
+const int CellCacheSize = 20000;
+const int TextMargin = 3;
+
+// Changes to more cells than this drop the whole cache rather than walking the range.
+const int ClearCellsLimit = 1000;
+
+}
+
+SalesOrderDelegate::SalesOrderDelegate(QAbstractItemModel* model, QObject* parent)
+    : QStyledItemDelegate(parent)
+    , model(0)
+    , cellCache(CellCacheSize)
+{
+    setModel(model);
+}
+
+void SalesOrderDelegate::setModel(QAbstractItemModel* pModel)
+{
+    if (model == pModel)
+        return;
+
+    if (model)
+        disconnect(model, 0, this, 0);
+
+    model = pModel;
+    cellCache.clear();
+    if (!model)
+        return;
+
+    // Cells are cached by position, so anything that moves rows drops them all.
+    connect(model, SIGNAL(modelReset()), SLOT(clearCache()));
+    connect(model, SIGNAL(layoutChanged()), SLOT(clearCache()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(clearCache()));
+    connect(model, SIGNAL(rowsRemoved(QModelIndex,int,int)), SLOT(clearCache()));
+    connect(model, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), SLOT(clearCache()));
+    connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(clearCells(QModelIndex,QModelIndex)));
+}
+
+void SalesOrderDelegate::clearCache()
+{
+    cellCache.clear();
+}
+
+void SalesOrderDelegate::clearCells(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    const int rows = bottomRight.row() - topLeft.row() + 1;
+    const int columns = bottomRight.column() - topLeft.column() + 1;
+    if (rows * columns > ClearCellsLimit) {
+        cellCache.clear();
+        return;
+    }
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        for (int column = topLeft.column(); column <= bottomRight.column(); column++)
+            cellCache.remove(key(row, column));
+    }
+}
+
+const SalesOrderDelegate::Cell* SalesOrderDelegate::cell(const QModelIndex& index, const QStyleOptionViewItem& option,
+                                                         int width) const
+{
+    if (option.font != cachedFont) {
+        cellCache.clear();
+        cachedFont = option.font;
+    }
+
+    const quint64 cellKey = key(index.row(), index.column());
+    Cell* cell = cellCache.object(cellKey);
+    if (cell && cell->width == width)
+        return cell;
+
+    cell = new Cell;
+    cell->width = width;
+    cell->alignment = index.data(Qt::TextAlignmentRole).toInt();
+    cell->background = index.data(Qt::BackgroundColorRole).value<QColor>();
+
+    const QString text = index.data(Qt::DisplayRole).toString();
+    cell->text.setText(QFontMetrics(option.font).elidedText(text, option.textElideMode, width));
+    cell->text.setTextFormat(Qt::PlainText);
+    cell->text.prepare(QTransform(), option.font);
+
+    cellCache.insert(cellKey, cell);
+    return cell;
+}
+
+void SalesOrderDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    // Paints straight from cached, pre-shaped cells, skipping the style machinery and the model.
+    const bool selected = option.state & QStyle::State_Selected;
+    const QRect rect = option.rect.adjusted(TextMargin, 0, -TextMargin, 0);
+    const Cell* c = cell(index, option, rect.width());
+
+    if (selected)
+        painter->fillRect(option.rect, option.palette.brush(QPalette::Highlight));
+    else if (c->background.isValid())
+        painter->fillRect(option.rect, c->background);
+    else if (option.features & QStyleOptionViewItem::Alternate)
+        painter->fillRect(option.rect, option.palette.brush(QPalette::AlternateBase));
+
+    if (!c->text.text().isEmpty()) {
+        const QSizeF size = c->text.size();
+
+        qreal x = rect.left();
+        if (c->alignment & Qt::AlignRight)
+            x = rect.right() - size.width();
+        else if (c->alignment & Qt::AlignHCenter)
+            x = rect.left() + (rect.width() - size.width()) / 2;
+
+        const qreal y = rect.top() + (rect.height() - size.height()) / 2;
+
+        painter->save();
+        painter->setClipRect(rect);
+        painter->setFont(option.font);
+        painter->setPen(option.palette.color(selected ? QPalette::HighlightedText : QPalette::Text));
+        painter->drawStaticText(QPointF(x, y), c->text);
+        painter->restore();
+    }
+
+    if (option.state & QStyle::State_HasFocus) {
+        QStyleOptionFocusRect focus;
+        focus.QStyleOption::operator=(option);
+        focus.state |= QStyle::State_KeyboardFocusChange;
+        focus.backgroundColor = option.palette.color(selected ? QPalette::Highlight : QPalette::Base);
+
+        QStyle* style = option.widget ? option.widget->style() : QApplication::style();
+        style->drawPrimitive(QStyle::PE_FrameFocusRect, &focus, painter, option.widget);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef SALESORDERDELEGATE_H
+#define SALESORDERDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QStaticText>
+#include <QCache>
+#include <QColor>
+
+class QAbstractItemModel;
+
+class SalesOrderDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    SalesOrderDelegate(QAbstractItemModel* model, QObject* parent);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+    // The model the view shows; the cache follows its changes and is dropped when it is replaced.
+    void setModel(QAbstractItemModel* model);
+
+public slots:
+    void clearCache();
+
+private slots:
+    void clearCells(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+private:
+    // What a cell paints, read from the model and shaped once: elided text, alignment and background.
+    struct Cell
+    {
+        QStaticText text;
+        int width;
+        int alignment;
+        QColor background;
+    };
+
+    static inline quint64 key(int row, int column) { return (quint64(quint32(row)) << 32) | quint32(column); }
+    const Cell* cell(const QModelIndex& index, const QStyleOptionViewItem& option, int width) const;
+
+    QAbstractItemModel* model;
+    mutable QCache<quint64, Cell> cellCache;
+    mutable QFont cachedFont;
+};
+
+#endif // SALESORDERDELEGATE_H
@@ -1,5 +1,16 @@
 #include "salesordereditor.h"
 #include "salesordereditorproductmodel.h"
+#include "columnschema.h"
+#include "db/writequeue.h"
+#include "db/preparedquery.h"
+#include "db/archiver.h"
+#include "products/productcatalog.h"
+#include "products/productdialog.h"
+#include "customers/customerdirectory.h"
+#include "customers/customercompletionmodel.h"
+#include "stock/stockledger.h"
+#include "diagnostics/stalldetector.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include <QMessageBox>
 #include <QColor>
@@ -28,6 +39,27 @@
 #include <QTextDocument>
 #include <QPainter>
 #include <QPushButton>
+#include <QCloseEvent>
+#include <QKeyEvent>
+#include <QApplication>
+#include <QClipboard>
+#include <QSet>
+
+namespace {
+
+// Scanners deliver keys faster than this (milliseconds); people do not.
+const int ScanKeyInterval = 30;
+const int ScanBurstWindow = 150;
+const int MinBarcodeLength = 4;
+
+// Lines are read in chunks of this many as the view scrolls, so large orders open as fast as small ones.
+const int DetailChunkSize = 256;
+
+// Saves store lastmod with its milliseconds, so that refresh() tells our own save from one made elsewhere
+// in the same second.
+const char* const LastmodFormat = "yyyy-MM-ddThh:mm:ss.zzz";
+
+}
 
 bool confirm(QWidget* parent, const QString& message, const QString& title = "Konfirmasi")
 {
@@ -40,6 +72,19 @@ bool confirm(QWidget* parent, const QString& message, const QString& title = "Ko
     return dialog.exec();
 }
 
+// The editor's columns, in display order: enum name and descriptor.
+#define SALES_ORDER_EDITOR_COLUMNS(X) \
+    X(IdColumn, MEMBER_COLUMN(Item, id, qlonglong, "ID", Qt::AlignRight, false, ColumnSchema::plain<qlonglong>)) \
+    X(NameColumn, MEMBER_COLUMN(Item, name, QString, "Nama Produk", Qt::AlignLeft, true, ColumnSchema::plain<QString>)) \
+    X(StockColumn, COMPUTED_COLUMN(Item, "Stok", Qt::AlignRight, false, stockValue, stockDisplay)) \
+    X(CostColumn, MEMBER_COLUMN(Item, cost, double, "Modal", Qt::AlignRight, true, ColumnSchema::money)) \
+    X(QuantityColumn, MEMBER_COLUMN(Item, quantity, int, "Kwantitas", Qt::AlignRight, true, ColumnSchema::number)) \
+    X(PriceColumn, MEMBER_COLUMN(Item, price, double, "Harga", Qt::AlignRight, true, ColumnSchema::money)) \
+    X(SubTotalColumn, COMPUTED_COLUMN(Item, "Sub Total", Qt::AlignRight, false, subTotalValue, subTotalDisplay))
+
+#define SALES_ORDER_EDITOR_COLUMN_ENUM(column, ...) column,
+#define SALES_ORDER_EDITOR_COLUMN_DESCRIPTOR(column, ...) __VA_ARGS__,
+
 void warn(QWidget* parent, const QString& message, const QString& title = "Peringatan")
 {
     QMessageBox dialog(parent);
@@ -56,14 +101,11 @@ class SalesOrderEditor::Model : public QAbstractTableModel
 public:
     qlonglong orderId;
     double total;
+    bool archived;
 
     enum Column {
-        IdColumn,
-        NameColumn,
-        CostColumn,
-        QuantityColumn,
-        PriceColumn,
-        SubTotalColumn
+        SALES_ORDER_EDITOR_COLUMNS(SALES_ORDER_EDITOR_COLUMN_ENUM)
+        ColumnCount
     };
 
     struct Item
@@ -71,51 +113,167 @@ public:
         inline Item()
             : id(0)
             , quantity(0)
+            , savedQuantity(0)
             , cost(0.0)
             , price(0.0)
+            , dirty(false)
         {}
 
         qlonglong id;
         QString name;
         int quantity;
+        int savedQuantity;
         double cost;
         double price;
+        bool dirty;
     };
-    QList<Item> items;
+    QVector<Item> items;
     QList<qlonglong> deletedIds;
 
+    static const ColumnDescriptor<Item> columns[];
+
 signals:
     void totalChanged();
 
 public:
-    Model(qlonglong orderId, QObject* parent)
+    Model(qlonglong orderId, bool archived, QObject* parent)
         : QAbstractTableModel(parent)
         , orderId(orderId)
         , total(0)
+        , archived(archived)
+        , lastLoadedId(0)
+        , fullyLoaded(true)
+    {
+        load();
+
+        connect(ProductCatalog::instance(), SIGNAL(productChanged(int)), SLOT(refreshStock()));
+        connect(ProductCatalog::instance(), SIGNAL(reloaded()), SLOT(refreshStock()));
+
+        // Line names point into the interned set, so each is counted there once.
+        MemoryAccounting::track(this, "SalesOrderEditor::Model", [this]() -> qint64 {
+            qint64 bytes = MemoryUsage::of(items) + MemoryUsage::of(deletedIds) + MemoryUsage::of(names);
+            for (const QString& name: names)
+                bytes += MemoryUsage::of(name);
+            return bytes;
+        });
+    }
+
+    void load()
     {
+        beginResetModel();
+        items.clear();
+        deletedIds.clear();
+        names.clear();
+        total = 0;
+        lastLoadedId = 0;
+        fullyLoaded = orderId == 0;
+
         if (orderId) {
-            QSqlQuery q;
-            q.prepare("select * from sales_order_details where parent_id=?");
-            q.bindValue(0, orderId);
-            q.exec();
-            while (q.next()) {
-                Item item;
-                item.id = q.value("id").toLongLong();
-                item.name = q.value("name").toString();
-                item.quantity = q.value("quantity").toInt();
-                item.cost = q.value("cost").toDouble();
-                item.price = q.value("price").toDouble();
-                items.append(item);
+            // The total covers lines that are not loaded yet; from here on every edit adjusts it by its difference.
+            PreparedQuery q(QString("select count(*), coalesce(sum(quantity * price), 0) from %1.sales_order_details"
+                                    " where parent_id=?").arg(database()));
+            q->bindValue(0, orderId);
+            q->exec();
+            if (q->next()) {
+                items.reserve(q->value(0).toInt());
+                total = q->value(1).toDouble();
             }
+
+            items += readChunk();
+        }
+
+        endResetModel();
+        emit totalChanged();
+    }
+
+    QVector<Item> readChunk()
+    {
+        QVector<Item> chunk;
+        chunk.reserve(DetailChunkSize);
+
+        PreparedQuery q(QString("select id, name, quantity, cost, price from %1.sales_order_details"
+                                " where parent_id=? and id>? order by id limit ?").arg(database()));
+        q->bindValue(0, orderId);
+        q->bindValue(1, lastLoadedId);
+        q->bindValue(2, DetailChunkSize);
+        q->exec();
+        while (q->next()) {
+            Item item;
+            item.id = q->value(0).toLongLong();
+            item.name = intern(q->value(1).toString());
+            item.quantity = q->value(2).toInt();
+            item.savedQuantity = item.quantity;
+            item.cost = q->value(3).toDouble();
+            item.price = q->value(4).toDouble();
+            chunk.append(item);
         }
+
+        if (!chunk.isEmpty())
+            lastLoadedId = chunk.last().id;
+        fullyLoaded = chunk.size() < DetailChunkSize;
+        return chunk;
+    }
+
+    bool canFetchMore(const QModelIndex& parent) const
+    {
+        return !parent.isValid() && !fullyLoaded;
+    }
+
+    void fetchMore(const QModelIndex& parent)
+    {
+        if (!canFetchMore(parent))
+            return;
+
+        const QVector<Item> chunk = readChunk();
+        if (chunk.isEmpty())
+            return;
+
+        // Loaded lines go before the trailing new-line row.
+        beginInsertRows(QModelIndex(), items.size(), items.size() + chunk.size() - 1);
+        items += chunk;
+        endInsertRows();
+    }
+
+    // Archived orders are read where they are kept until they are restored.
+    QString database() const
+    {
+        return archived ? "archive" : "main";
+    }
+
+    // Appending, merging scans and printing need every line in place.
+    void fetchAll()
+    {
+        while (!fullyLoaded)
+            fetchMore(QModelIndex());
+    }
+
+    // The lines of an order repeat a handful of product names; each is stored once and shared.
+    const QString& intern(const QString& name)
+    {
+        QSet<QString>::const_iterator it = names.constFind(name);
+        if (it == names.constEnd())
+            it = names.insert(name);
+        return *it;
+    }
+
+    void addToTotal(double delta)
+    {
+        if (delta == 0.0)
+            return;
+
+        total += delta;
+        emit totalChanged();
     }
 
     Qt::ItemFlags flags(const QModelIndex &index) const
     {
         Qt::ItemFlags f(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
 
+        if (archived)
+            return f;
+
         if ((index.row() == rowCount() - 1 && index.column() == NameColumn)
-            || (index.row() < rowCount() - 1 && (index.column() != IdColumn && index.column() != SubTotalColumn)))
+            || (index.row() < rowCount() - 1 && columns[index.column()].editable))
             f |= Qt::ItemIsEditable;
 
         return f;
@@ -128,7 +286,7 @@ public:
 
     int columnCount(const QModelIndex & = QModelIndex()) const
     {
-        return 6;
+        return ColumnCount;
     }
 
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const
@@ -136,40 +294,22 @@ public:
         if (index.row() == rowCount() - 1)
             return QVariant();
 
-        const Item item = items.at(index.row());
+        const Item& item = items.at(index.row());
+        const ColumnDescriptor<Item>& column = columns[index.column()];
 
-        if (role == Qt::DisplayRole) {
-            QLocale locale;
-            switch (index.column()) {
-            case CostColumn: return locale.toString(item.cost, 'f', 0);
-            case QuantityColumn: return locale.toString(item.quantity);
-            case PriceColumn: return locale.toString(item.price, 'f', 0);
-            case SubTotalColumn: return locale.toString(item.quantity * item.price, 'f', 0);
+        if (role == Qt::DisplayRole)
+            return column.display(item);
+        else if (role == Qt::EditRole)
+            return column.value(item);
+        else if (role == Qt::TextAlignmentRole)
+            return column.alignment | Qt::AlignVCenter;
+        else if (role == Qt::BackgroundColorRole) {
+            // Untracked products have no stock cell to colour.
+            if (index.column() == StockColumn) {
+                int stock = 0;
+                return projectedStock(item, stock) && stock < 0 ? QColor("#ffdddd") : QVariant();
             }
-        }
 
-        if (role == Qt::DisplayRole || role == Qt::EditRole) {
-            switch (index.column()) {
-            case IdColumn: return item.id;
-            case NameColumn: return item.name;
-            case CostColumn: return item.cost;
-            case QuantityColumn: return item.quantity;
-            case PriceColumn: return item.price;
-            case SubTotalColumn: return item.quantity * item.price;
-            default: return QVariant();
-            }
-        }
-        else if (role == Qt::TextAlignmentRole) {
-            switch (index.column()) {
-            case IdColumn: return Qt::AlignVCenter ^ Qt::AlignRight;
-            case CostColumn: return Qt::AlignVCenter ^ Qt::AlignRight;
-            case QuantityColumn: return Qt::AlignVCenter ^ Qt::AlignRight;
-            case PriceColumn: return Qt::AlignVCenter ^ Qt::AlignRight;
-            case SubTotalColumn: return Qt::AlignVCenter ^ Qt::AlignRight;
-            default: return Qt::AlignVCenter ^ Qt::AlignLeft;
-            }
-        }
-        else if (role == Qt::BackgroundColorRole) {
             if (item.price == item.cost)
                 return QColor("#ffffdd");
             else if (item.price < item.cost) {
@@ -180,19 +320,34 @@ public:
         return QVariant();
     }
 
+    static QVariant stockValue(const Item& item)
+    {
+        int stock = 0;
+        return projectedStock(item, stock) ? QVariant(stock) : QVariant();
+    }
+
+    static QVariant stockDisplay(const Item& item)
+    {
+        int stock = 0;
+        return projectedStock(item, stock) ? QVariant(QLocale().toString(stock)) : QVariant();
+    }
+
+    static QVariant subTotalValue(const Item& item)
+    {
+        return item.quantity * item.price;
+    }
+
+    static QVariant subTotalDisplay(const Item& item)
+    {
+        return QLocale().toString(item.quantity * item.price, 'f', 0);
+    }
+
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const
     {
         if (orientation == Qt::Horizontal) {
-            if (role == Qt::DisplayRole) {
-                switch (section) {
-                case IdColumn: return "ID";
-                case NameColumn: return "Nama Produk";
-                case CostColumn: return "Modal";
-                case QuantityColumn: return "Kwantitas";
-                case PriceColumn: return "Harga";
-                case SubTotalColumn: return "Sub Total";
-                }
-            }
+            if (role == Qt::DisplayRole && section >= 0 && section < ColumnCount)
+                return columns[section].label;
+            return QVariant();
         }
 
         if (role == Qt::DisplayRole) {
@@ -214,18 +369,42 @@ public:
             if (name.isEmpty())
                 return false;
 
+            // A scanned barcode or a known product name fills in the catalog's cost and price.
+            const ProductCatalog* catalog = ProductCatalog::instance();
+            const int productIndex = catalog->find(name);
+            const bool hasDefaults = productIndex >= 0
+                    && (catalog->at(productIndex).cost != 0.0 || catalog->at(productIndex).price != 0.0);
+            if (productIndex >= 0)
+                name = catalog->at(productIndex).name;
+
             if (index.row() == rowCount() - 1) {
-                int row = rowCount();
+                fetchAll();
+                int row = items.size();
                 beginInsertRows(QModelIndex(), row, row);
                 Item item;
-                item.name = name;
+                item.name = intern(name);
+                if (hasDefaults) {
+                    item.cost = catalog->at(productIndex).cost;
+                    item.price = catalog->at(productIndex).price;
+                }
+                item.dirty = true;
                 items.append(item);
                 endInsertRows();
             }
             else {
-                items[index.row()].name = name;
-                emit dataChanged(index, index);
+                Item &item = items[index.row()];
+                if (item.name == name)
+                    return true;
+                item.name = intern(name);
+                if (hasDefaults) {
+                    addToTotal(item.quantity * (catalog->at(productIndex).price - item.price));
+                    item.cost = catalog->at(productIndex).cost;
+                    item.price = catalog->at(productIndex).price;
+                }
+                item.dirty = true;
+                emit dataChanged(index.sibling(index.row(), IdColumn), index.sibling(index.row(), SubTotalColumn));
             }
+
             return true;
         }
 
@@ -240,15 +419,26 @@ public:
             }
 
             item.cost = cost;
+            item.dirty = true;
         }
         else if (index.column() == QuantityColumn) {
             int quantity = value.toInt();
             if (item.quantity == quantity)
                 return true;
+            const double delta = (quantity - item.quantity) * item.price;
             item.quantity = quantity;
+            item.dirty = true;
             QModelIndex subTotalIndex = index.sibling(index.row(), SubTotalColumn);
             emit dataChanged(subTotalIndex, subTotalIndex);
-            updateTotal();
+            QModelIndex stockIndex = index.sibling(index.row(), StockColumn);
+            emit dataChanged(stockIndex, stockIndex);
+            addToTotal(delta);
+
+            int stock = 0;
+            if (quantity > item.savedQuantity && projectedStock(item, stock) && stock < 0) {
+                QMessageBox::warning(0, "Peringatan", QString("Stok %1 tidak mencukupi, stok akan menjadi %2.")
+                                     .arg(item.name, QLocale().toString(stock)));
+            }
         }
         else if (index.column() == PriceColumn) {
             double price = value.toDouble();
@@ -257,10 +447,12 @@ public:
             if (price < item.cost && confirmNegativeProfit())
                 return false;
 
+            const double delta = item.quantity * (price - item.price);
             item.price = price;
+            item.dirty = true;
             QModelIndex subTotalIndex = index.sibling(index.row(), SubTotalColumn);
             emit dataChanged(subTotalIndex, subTotalIndex);
-            updateTotal();
+            addToTotal(delta);
         }
 
         emit dataChanged(index, index);
@@ -268,79 +460,282 @@ public:
         return true;
     }
 
-    void updateTotal()
+    void appendItems(const QList<Item>& newItems)
     {
-        total = 0.;
-        for (const Item item: items) {
-            total += item.quantity * item.price;
+        insertItems(newItems);
+    }
+
+    // Repeated scans of the same product become quantity increments instead of new lines.
+    void addScans(const QStringList& codes)
+    {
+        const ProductCatalog* catalog = ProductCatalog::instance();
+
+        fetchAll();
+
+        QHash<QString, int> rowByName;
+        for (int row = items.size() - 1; row >= 0; row--)
+            rowByName.insert(ProductCatalog::normalize(items.at(row).name), row);
+
+        QList<Item> newItems;
+        QHash<QString, int> newItemByName;
+        int firstChangedRow = items.size();
+        int lastChangedRow = -1;
+        double delta = 0;
+
+        for (const QString& code: codes) {
+            const int productIndex = catalog->find(code);
+            const QString name = productIndex >= 0 ? catalog->at(productIndex).name : code;
+            const QString key = ProductCatalog::normalize(name);
+
+            const int row = rowByName.value(key, -1);
+            if (row >= 0) {
+                items[row].quantity++;
+                items[row].dirty = true;
+                delta += items.at(row).price;
+                firstChangedRow = qMin(firstChangedRow, row);
+                lastChangedRow = qMax(lastChangedRow, row);
+                continue;
+            }
+
+            const int newItem = newItemByName.value(key, -1);
+            if (newItem >= 0) {
+                newItems[newItem].quantity++;
+                continue;
+            }
+
+            Item item;
+            item.name = name;
+            item.quantity = 1;
+            if (productIndex >= 0) {
+                item.cost = catalog->at(productIndex).cost;
+                item.price = catalog->at(productIndex).price;
+            }
+            newItemByName.insert(key, newItems.size());
+            newItems.append(item);
         }
-        emit totalChanged();
+
+        if (lastChangedRow >= 0)
+            emit dataChanged(index(firstChangedRow, StockColumn), index(lastChangedRow, SubTotalColumn));
+
+        addToTotal(delta);
+        insertItems(newItems);
+    }
+
+    void insertItems(const QList<Item>& newItems)
+    {
+        if (newItems.isEmpty())
+            return;
+
+        fetchAll();
+
+        const int first = items.size();
+        double delta = 0;
+        beginInsertRows(QModelIndex(), first, first + newItems.size() - 1);
+        items.reserve(items.size() + newItems.size());
+        for (Item item: newItems) {
+            item.name = intern(item.name);
+            item.dirty = true;
+            delta += item.quantity * item.price;
+            items.append(item);
+        }
+        endInsertRows();
+
+        addToTotal(delta);
+    }
+
+    // Catalog stock already includes this order's saved quantities, so only the unsaved difference is applied.
+    static bool projectedStock(const Item& item, int& stock)
+    {
+        const ProductCatalog* catalog = ProductCatalog::instance();
+        const int productIndex = catalog->indexOfName(item.name);
+        if (productIndex < 0 || !catalog->at(productIndex).stockTracked)
+            return false;
+
+        stock = catalog->at(productIndex).stock - (item.quantity - item.savedQuantity);
+        return true;
     }
 
-    void save() {
-        QSqlQuery q;
+    bool isDirty() const
+    {
+        if (!deletedIds.isEmpty())
+            return true;
 
-        for (qlonglong id: deletedIds) {
-            q.prepare("delete from sales_order_details where id=?");
-            q.bindValue(0, id);
-            q.exec();
+        for (const Item& item: items) {
+            if (item.dirty)
+                return true;
         }
 
-        for (Item& item: items) {
+        return false;
+    }
+
+    struct Changes
+    {
+        QList<qlonglong> deletedIds;
+        QList<int> rows;
+        QList<Item> items;
+    };
+
+    Changes saving;
+
+    const Changes& beginSave()
+    {
+        saving = Changes();
+        saving.deletedIds = deletedIds;
+        for (int row = 0; row < items.size(); row++) {
+            if (items.at(row).dirty) {
+                saving.rows.append(row);
+                saving.items.append(items.at(row));
+            }
+        }
+        return saving;
+    }
+
+    // Runs on the writer thread, so it only touches the snapshot it is given.
+    static bool write(QSqlDatabase& db, qlonglong orderId, const Changes& changes, QVariantMap& result)
+    {
+        for (qlonglong id: changes.deletedIds) {
+            PreparedQuery q("delete from sales_order_details where id=?", db);
+            q->bindValue(0, id);
+            if (!q->exec())
+                return false;
+        }
+
+        QVariantList ids;
+        QVariantList products;
+        for (const Item& item: changes.items) {
+            // The product is created first, so that the line can record its id.
+            PreparedQuery product("insert or ignore into products (name, cost, price) values (:name, :cost, :price)", db);
+            product->bindValue(":name", item.name);
+            product->bindValue(":cost", item.cost);
+            product->bindValue(":price", item.price);
+            if (!product->exec())
+                return false;
+
+            if (product->numRowsAffected() > 0) {
+                QVariantMap created;
+                created.insert("id", product->lastInsertId());
+                created.insert("name", item.name);
+                created.insert("cost", item.cost);
+                created.insert("price", item.price);
+                products.append(created);
+            }
+
+            // Stock is posted by product id, so a line keeps the product it was written for even when the
+            // product is renamed later; only a new name resolves it again.
             if (item.id == 0) {
-                q.prepare("insert into sales_order_details("
-                          " parent_id, name, quantity, cost, price, profit"
-                          ")values("
-                          ":parent_id,:name,:quantity,:cost,:price,:profit"
-                          ")");
-                q.bindValue(":parent_id", orderId);
+                PreparedQuery q("insert into sales_order_details("
+                                " parent_id, name, quantity, cost, price, profit, product_id"
+                                ")values("
+                                ":parent_id,:name,:quantity,:cost,:price,:profit,"
+                                "(select id from products where name=:product)"
+                                ")", db);
+                q->bindValue(":parent_id", orderId);
+                if (!exec(*q, item))
+                    return false;
+                ids.append(q->lastInsertId().toLongLong());
             }
             else {
-                q.prepare("update sales_order_details set"
-                          " name=:name"
-                          ",quantity=:quantity"
-                          ",cost=:cost"
-                          ",price=:price"
-                          ",profit=:profit"
-                          " where id=:id");
-                q.bindValue(":id", item.id);
+                PreparedQuery q("update sales_order_details set"
+                                " name=:name"
+                                ",quantity=:quantity"
+                                ",cost=:cost"
+                                ",price=:price"
+                                ",profit=:profit"
+                                ",product_id=coalesce(case when name=:kept_name then product_id end,"
+                                " (select id from products where name=:product))"
+                                " where id=:id", db);
+                q->bindValue(":id", item.id);
+                q->bindValue(":kept_name", item.name);
+                if (!exec(*q, item))
+                    return false;
+                ids.append(item.id);
             }
+        }
 
-            q.bindValue(":name", item.name);
-            q.bindValue(":cost", item.cost);
-            q.bindValue(":price", item.price);
-            q.bindValue(":quantity", item.quantity);
-            q.bindValue(":profit", (item.quantity * item.price) - item.quantity * item.cost);
-            q.exec();
+        result.insert("itemIds", ids);
+        result.insert("products", products);
+        return true;
+    }
 
-            if (item.id == 0) {
-                item.id = q.lastInsertId().toLongLong();
-            }
+    static bool exec(QSqlQuery& q, const Item& item)
+    {
+        q.bindValue(":name", item.name);
+        q.bindValue(":product", item.name);
+        q.bindValue(":cost", item.cost);
+        q.bindValue(":price", item.price);
+        q.bindValue(":quantity", item.quantity);
+        q.bindValue(":profit", (item.quantity * item.price) - item.quantity * item.cost);
+        return q.exec();
+    }
+
+    void markSaved(const QVariantMap& result)
+    {
+        const QVariantList ids = result.value("itemIds").toList();
+        for (int i = 0; i < saving.rows.size() && i < ids.size(); i++) {
+            Item& item = items[saving.rows.at(i)];
+            item.id = ids.at(i).toLongLong();
+            item.savedQuantity = saving.items.at(i).quantity;
+            item.dirty = false;
+        }
 
-            q.prepare("insert or ignore into products (name) values (:name)");
-            q.bindValue(":name", item.name);
-            q.exec();
+        for (qlonglong id: saving.deletedIds)
+            deletedIds.removeOne(id);
+
+        saving = Changes();
+
+        for (const QVariant& value: result.value("products").toList()) {
+            const QVariantMap map = value.toMap();
+            ProductCatalog::Product product;
+            product.id = map.value("id").toLongLong();
+            product.name = map.value("name").toString();
+            product.cost = map.value("cost").toDouble();
+            product.price = map.value("price").toDouble();
+            ProductCatalog::instance()->update(product);
         }
 
-        ProductModel::instance()->refresh();
+        ProductCatalog::instance()->updateStock(result.value("stock").toList());
     }
 
     bool removeRows(int row, int /*count*/, const QModelIndex &parent = QModelIndex())
     {
         beginRemoveRows(parent, row, row);
-        Item item = items.takeAt(row);
+        const Item& item = items.at(row);
         if (item.id != 0)
             deletedIds.append(item.id);
+        const double delta = -item.quantity * item.price;
+        items.remove(row);
         endRemoveRows();
+
+        addToTotal(delta);
         return true;
     }
 
+public slots:
+    void refreshStock()
+    {
+        if (!items.isEmpty())
+            emit dataChanged(index(0, StockColumn), index(items.size() - 1, StockColumn));
+    }
+
+public:
     bool confirmNegativeProfit() const
     {
         return QMessageBox::question(0, "Konfirmasi", "Harga lebih kecil dari modal, lanjutkan perubahan?", "&Ya", "&Tidak");
     }
+
+private:
+    QSet<QString> names;
+    qlonglong lastLoadedId;
+    bool fullyLoaded;
+};
+
+const ColumnDescriptor<SalesOrderEditor::Model::Item> SalesOrderEditor::Model::columns[] = {
+    SALES_ORDER_EDITOR_COLUMNS(SALES_ORDER_EDITOR_COLUMN_DESCRIPTOR)
 };
 
+static_assert(sizeof(SalesOrderEditor::Model::columns) / sizeof(SalesOrderEditor::Model::columns[0])
+              == SalesOrderEditor::Model::ColumnCount, "one descriptor per column");
+
 class SalesOrderEditor::Delegate : public QStyledItemDelegate
 {
 public:
@@ -406,18 +801,23 @@ public:
 
 };
 
-SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
+SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent, bool archived)
     : QWidget(parent)
     , id(id)
-    , model(new Model(id, this))
+    , model(new Model(id, archived, this))
     , delegate(new Delegate(this))
+    , saveTicket(0)
+    , removeTicket(0)
+    , restoreTicket(0)
+    , printAfterSave(false)
+    , replayingKeys(false)
 {
     QToolBar* toolBar = new QToolBar(this);
     toolBar->setIconSize(QSize(16, 16));
 
     QString actionToolTip("%1<br><b>%2</b>");
 
-    QAction* saveAction = toolBar->addAction(QIcon(":/resources/icons/save.png"), "", this, SLOT(save()));
+    saveAction = toolBar->addAction(QIcon(":/resources/icons/save.png"), "", this, SLOT(save()));
     saveAction->setShortcut(QKeySequence("Ctrl+S"));
     saveAction->setToolTip(actionToolTip.arg("Simpan order").arg("Ctrl+S"));
 
@@ -427,10 +827,14 @@ SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
 
     toolBar->addSeparator();
 
-    QAction* removeAction = toolBar->addAction(QIcon(":/resources/icons/remove.png"), "", this, SLOT(remove()));
+    removeAction = toolBar->addAction(QIcon(":/resources/icons/remove.png"), "", this, SLOT(remove()));
     removeAction->setShortcut(QKeySequence("Ctrl+Shift+Del"));
     removeAction->setToolTip(actionToolTip.arg("Hapus rekaman pesanan").arg("Ctrl+Shift+Del"));
 
+    restoreAction = toolBar->addAction(QIcon(":/resources/icons/refresh.png"), "", this, SLOT(restore()));
+    restoreAction->setShortcut(QKeySequence("Ctrl+E"));
+    restoreAction->setToolTip(actionToolTip.arg("Pulihkan pesanan dari arsip untuk diubah").arg("Ctrl+E"));
+
     QGroupBox* orderInfoGroupBox = new QGroupBox("Pesanan", this);
     QFormLayout* orderInfoLayout = new QFormLayout(orderInfoGroupBox);
 
@@ -465,6 +869,9 @@ SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
     customerAddressEdit->setMaxLength(100);
     customerInfoLayout->addRow("&Alamat", customerAddressEdit);
 
+    setupCustomerCompleter(customerNameEdit, CustomerDirectory::NameField);
+    setupCustomerCompleter(customerContactEdit, CustomerDirectory::ContactField);
+
     QBoxLayout* layout1 = new QHBoxLayout;
     layout1->addWidget(customerInfoGroupBox);
     layout1->addWidget(orderInfoGroupBox);
@@ -478,7 +885,8 @@ SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
     view->setSelectionBehavior(QAbstractItemView::SelectItems);
     view->setTabKeyNavigation(false);
     view->setEditTriggers(QAbstractItemView::EditKeyPressed | QAbstractItemView::AnyKeyPressed | QAbstractItemView::DoubleClicked);
-    view->viewport()->setToolTip("Daftar produk. Ketuk tombol <b>Del</b> untuk menghapus produk yang dipilih.");
+    view->viewport()->setToolTip("Daftar produk. Ketuk tombol <b>Del</b> untuk menghapus produk yang dipilih,"
+                                 " <b>Ctrl+B</b> untuk mengatur barcode, modal dan harganya.");
     QHeaderView* header = view->horizontalHeader();
     header->setHighlightSections(false);
     header = view->verticalHeader();
@@ -491,6 +899,26 @@ SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
     removeItemAction->setShortcut(QKeySequence("Del"));
     view->addAction(removeItemAction);
 
+    QAction* pasteItemsAction = new QAction(view);
+    pasteItemsAction->setShortcut(QKeySequence::Paste);
+    pasteItemsAction->setShortcutContext(Qt::WidgetShortcut);
+    view->addAction(pasteItemsAction);
+
+    QAction* editProductAction = new QAction(view);
+    editProductAction->setShortcut(QKeySequence("Ctrl+B"));
+    editProductAction->setShortcutContext(Qt::WidgetShortcut);
+    view->addAction(editProductAction);
+
+    scanKeyTimer = new QTimer(this);
+    scanKeyTimer->setSingleShot(true);
+    scanKeyTimer->setInterval(ScanKeyInterval * 2);
+
+    scanFlushTimer = new QTimer(this);
+    scanFlushTimer->setSingleShot(true);
+    scanFlushTimer->setInterval(ScanBurstWindow);
+
+    view->installEventFilter(this);
+
     infoLabel = new QLabel(this);
     infoLabel->setStyleSheet("font-style:italic;padding-bottom:1px;");
     infoLabel->setText("Belum disimpan");
@@ -515,34 +943,95 @@ SalesOrderEditor::SalesOrderEditor(qlonglong id, QWidget* parent)
 
     if (id == 0) {
         printAction->setEnabled(false);
-        removeAction->setEnabled(false);
         openDateTimeEdit->setDateTime(QDateTime::currentDateTime());
         stateComboBox->setCurrentIndex(0);
         totalEdit->setText("0");
     }
-    else {
-        QSqlQuery q;
-        q.prepare("select * from sales_orders where id=?");
-        q.bindValue(0, id);
-        q.exec();
-        q.next();
-        idEdit->setText(QString::number(q.value("id").toLongLong()));
-        openDateTimeEdit->setDateTime(q.value("open_datetime").toDateTime());
-        stateComboBox->setCurrentIndex(q.value("state").toInt());
-        customerNameEdit->setText(q.value("customer_name").toString());
-        customerContactEdit->setText(q.value("customer_contact").toString());
-        customerAddressEdit->setText(q.value("customer_address").toString());
-        totalEdit->setText(QLocale().toString(q.value("grand_total").toDouble(), 'f', 0));
-        setInfoLabel(q.value("lastmod_datetime").toDateTime());
-    }
+    else
+        loadHeader();
+
+    savedHeader = currentHeader();
+    updateReadOnly();
 
     connect(model, SIGNAL(totalChanged()), SLOT(updateTotal()));
+    connect(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)), SLOT(onWriteFinished(int,bool,QVariantMap)));
     connect(removeItemAction, SIGNAL(triggered(bool)), SLOT(removeCurrentItem()));
+    connect(pasteItemsAction, SIGNAL(triggered(bool)), SLOT(pasteItems()));
+    connect(editProductAction, SIGNAL(triggered(bool)), SLOT(editCurrentProduct()));
+    connect(scanKeyTimer, SIGNAL(timeout()), SLOT(replayKeys()));
+    connect(scanFlushTimer, SIGNAL(timeout()), SLOT(flushScans()));
+
+    // The widgets are Qt's; what the editor itself holds is the scanner input waiting to be replayed.
+    MemoryAccounting::track(this, "SalesOrderEditor", [this]() -> qint64 {
+        qint64 bytes = sizeof(SalesOrderEditor) + MemoryUsage::of(bufferedKeys) + MemoryUsage::of(pendingScans);
+        for (const BufferedKey& key: bufferedKeys)
+            bytes += MemoryUsage::of(key.text);
+        for (const QString& scan: pendingScans)
+            bytes += MemoryUsage::of(scan);
+        return bytes;
+    });
 
     updateWindowTitle();
     QTimer::singleShot(0, this, SLOT(init()));
 }
 
+bool SalesOrderEditor::loadHeader()
+{
+    PreparedQuery q(QString("select id, open_datetime, state, customer_name, customer_contact, customer_address,"
+                            " grand_total, lastmod_datetime from %1.sales_orders where id=?").arg(model->database()));
+    q->bindValue(0, id);
+    q->exec();
+    if (!q->next())
+        return false;
+
+    idEdit->setText(QString::number(q->value(0).toLongLong()));
+    openDateTimeEdit->setDateTime(q->value(1).toDateTime());
+    stateComboBox->setCurrentIndex(q->value(2).toInt());
+    customerNameEdit->setText(q->value(3).toString());
+    customerContactEdit->setText(q->value(4).toString());
+    customerAddressEdit->setText(q->value(5).toString());
+    totalEdit->setText(QLocale().toString(q->value(6).toDouble(), 'f', 0));
+    savedLastmod = q->value(7).toDateTime();
+    setInfoLabel(savedLastmod);
+    return true;
+}
+
+void SalesOrderEditor::refresh()
+{
+    if (!id || model->archived || saveTicket || removeTicket || restoreTicket)
+        return;
+
+    PreparedQuery q("select lastmod_datetime from sales_orders where id=?");
+    q->bindValue(0, id);
+    q->exec();
+
+    if (!q->next()) {
+        infoLabel->setText("Pesanan telah dihapus di tempat lain.");
+        return;
+    }
+
+    // Our own saves come back through the watcher too.
+    if (q->value(0).toDateTime() == savedLastmod)
+        return;
+
+    const Header header = currentHeader();
+    const bool edited = model->isDirty()
+            || header.openDateTime != savedHeader.openDateTime
+            || header.state != savedHeader.state
+            || header.customerName != savedHeader.customerName
+            || header.customerContact != savedHeader.customerContact
+            || header.customerAddress != savedHeader.customerAddress;
+
+    if (edited) {
+        infoLabel->setText("Pesanan telah diubah di tempat lain, simpan untuk menimpa.");
+        return;
+    }
+
+    loadHeader();
+    model->load();
+    savedHeader = currentHeader();
+}
+
 void SalesOrderEditor::init()
 {
     customerNameEdit->setFocus();
@@ -552,107 +1041,324 @@ void SalesOrderEditor::init()
     header->setSectionResizeMode(Model::NameColumn, QHeaderView::Stretch);
 }
 
+void SalesOrderEditor::setupCustomerCompleter(QLineEdit* edit, int field)
+{
+    CustomerCompletionModel* completionModel = new CustomerCompletionModel(CustomerDirectory::Field(field), edit);
+
+    QCompleter* completer = new QCompleter(completionModel, edit);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->popup()->setAlternatingRowColors(true);
+    edit->setCompleter(completer);
+
+    connect(edit, SIGNAL(textEdited(QString)), completionModel, SLOT(setPrefix(QString)));
+    connect(completer, SIGNAL(activated(QModelIndex)), SLOT(fillCustomer(QModelIndex)));
+}
+
+void SalesOrderEditor::fillCustomer(const QModelIndex& index)
+{
+    const int customerIndex = index.data(CustomerCompletionModel::CustomerIndexRole).toInt();
+    const CustomerDirectory::Customer& customer = CustomerDirectory::instance()->at(customerIndex);
+
+    customerNameEdit->setText(customer.name);
+    customerContactEdit->setText(customer.contact);
+    customerAddressEdit->setText(customer.address);
+    view->setFocus();
+}
+
+void SalesOrderEditor::updateReadOnly()
+{
+    const bool archived = model->archived;
+    saveAction->setEnabled(!archived);
+    removeAction->setEnabled(id && !archived);
+    restoreAction->setVisible(archived);
+
+    openDateTimeEdit->setEnabled(!archived);
+    stateComboBox->setEnabled(!archived);
+    customerNameEdit->setReadOnly(archived);
+    customerContactEdit->setReadOnly(archived);
+    customerAddressEdit->setReadOnly(archived);
+}
+
 void SalesOrderEditor::updateWindowTitle()
 {
     setWindowTitle(id ? QString("#%1").arg(QString::number(id)) : "Baru");
 }
 
+SalesOrderEditor::Header SalesOrderEditor::currentHeader() const
+{
+    Header header;
+    header.openDateTime = openDateTimeEdit->dateTime();
+    header.state = stateComboBox->currentIndex();
+    header.customerName = customerNameEdit->text().trimmed();
+    header.customerContact = customerContactEdit->text().trimmed();
+    header.customerAddress = customerAddressEdit->text().trimmed();
+    header.grandTotal = QLocale().toDouble(totalEdit->text());
+    return header;
+}
+
 void SalesOrderEditor::save()
 {
-    const QString customerName = customerNameEdit->text().trimmed();
-    if (customerName.isEmpty()) {
+    StallScope scope("SalesOrderEditor::save");
+    submitSave();
+}
+
+bool SalesOrderEditor::submitSave()
+{
+    if (saveTicket || restoreTicket)
+        return false;
+
+    // Nothing can have changed on an archived order; printing it needs no save.
+    if (model->archived)
+        return true;
+
+    const Header header = currentHeader();
+    if (header.customerName.isEmpty()) {
         customerNameEdit->setFocus();
         warn(this, "Nama pelanggan harus diisi.");
-        return;
+        return false;
     }
 
+    QVariantMap changes;
+    if (!id || header.openDateTime != savedHeader.openDateTime)
+        changes.insert("open_datetime", header.openDateTime);
+    if (!id || header.state != savedHeader.state)
+        changes.insert("state", header.state);
+    if (!id || header.customerName != savedHeader.customerName)
+        changes.insert("customer_name", header.customerName);
+    if (!id || header.customerContact != savedHeader.customerContact)
+        changes.insert("customer_contact", header.customerContact);
+    if (!id || header.customerAddress != savedHeader.customerAddress)
+        changes.insert("customer_address", header.customerAddress);
+    if (!id || header.grandTotal != savedHeader.grandTotal)
+        changes.insert("grand_total", header.grandTotal);
+
+    if (changes.isEmpty() && !model->isDirty())
+        return true;
+
     const QDateTime now = QDateTime::currentDateTime();
+    changes.insert("lastmod_datetime", now.toString(LastmodFormat));
 
-    QSqlDatabase db = QSqlDatabase::database();
-    db.transaction();
+    const qlonglong orderId = id;
+    const Model::Changes itemChanges = model->beginSave();
 
-    QSqlQuery q(db);
-    QString sql;
-    if (!id) {
-        sql = "insert into sales_orders("
-              " open_datetime, state,"
-              " customer_name, customer_contact, customer_address,"
-              " grand_total,"
-              " lastmod_datetime"
-              ") values ("
-              ":open_datetime,:state,"
-              ":customer_name,:customer_contact,:customer_address,"
-              ":grand_total,"
-              ":lastmod_datetime"
-              ")";
-    }
-    else {
-        sql = "update sales_orders set"
-              " open_datetime=:open_datetime"
-              ",state=:state"
-              ",customer_name=:customer_name"
-              ",customer_contact=:customer_contact"
-              ",customer_address=:customer_address"
-              ",grand_total=:grand_total"
-              ",lastmod_datetime=:lastmod_datetime"
-              " where id=:id";
-    }
-    q.prepare(sql);
-    q.bindValue(":open_datetime", openDateTimeEdit->dateTime());
-    q.bindValue(":state", stateComboBox->currentIndex());
-    q.bindValue(":customer_name", customerName);
-    q.bindValue(":customer_contact", customerContactEdit->text().trimmed());
-    q.bindValue(":customer_address", customerAddressEdit->text().trimmed());
-    q.bindValue(":grand_total", QLocale().toDouble(totalEdit->text()));
-    q.bindValue(":lastmod_datetime", now);
-
-    if (id)
-        q.bindValue(":id", id);
-
-    q.exec();
+    saveTicket = WriteQueue::instance()->submit([orderId, header, changes, itemChanges](QSqlDatabase& db, QVariantMap& result) {
+        QStringList columns = changes.keys();
+        QString sql;
+        if (!orderId) {
+            sql = QString("insert into sales_orders(%1) values (:%2)")
+                    .arg(columns.join(", "), columns.join(",:"));
+        }
+        else {
+            QStringList assignments;
+            for (const QString& column: columns)
+                assignments.append(column + "=:" + column);
+            sql = QString("update sales_orders set %1 where id=:id").arg(assignments.join(","));
+        }
+        PreparedQuery q(sql, db);
+        for (const QString& column: columns)
+            q->bindValue(":" + column, changes.value(column));
+
+        if (orderId)
+            q->bindValue(":id", orderId);
+
+        if (!q->exec())
+            return false;
+
+        const qlonglong id = orderId ? orderId : q->lastInsertId().toLongLong();
+        result.insert("id", id);
+
+        if (changes.contains("customer_name") || changes.contains("customer_contact") || changes.contains("customer_address")) {
+            if (!saveCustomer(db, header, result))
+                return false;
+        }
+
+        if (!Model::write(db, id, itemChanges, result))
+            return false;
+
+        QVariantList balances;
+        if (!StockLedger::postOrder(db, id, balances))
+            return false;
+
+        result.insert("stock", balances);
+        return true;
+    });
+
+    pendingHeader = header;
+    pendingSaveTime = now;
+
+    setEnabled(false);
+    infoLabel->setText("Menyimpan...");
+    return true;
+}
+
+bool SalesOrderEditor::saveCustomer(QSqlDatabase& db, const Header& header, QVariantMap& result)
+{
+    PreparedQuery insert("insert or ignore into customers (name, contact, address) values (?, ?, ?)", db);
+    insert->bindValue(0, header.customerName);
+    insert->bindValue(1, header.customerContact);
+    insert->bindValue(2, header.customerAddress);
+    if (!insert->exec())
+        return false;
+
+    if (insert->numRowsAffected() == 0 && !header.customerAddress.isEmpty()) {
+        PreparedQuery update("update customers set address=? where name=? collate nocase and contact=?", db);
+        update->bindValue(0, header.customerAddress);
+        update->bindValue(1, header.customerName);
+        update->bindValue(2, header.customerContact);
+        if (!update->exec())
+            return false;
+    }
+
+    PreparedQuery select("select id from customers where name=? collate nocase and contact=?", db);
+    select->bindValue(0, header.customerName);
+    select->bindValue(1, header.customerContact);
+    if (!select->exec())
+        return false;
+
+    if (select->next())
+        result.insert("customerId", select->value(0));
+
+    return true;
+}
+
+void SalesOrderEditor::onWriteFinished(int ticket, bool ok, const QVariantMap& result)
+{
+    StallScope scope("SalesOrderEditor::onWriteFinished");
+    if (ticket == restoreTicket) {
+        restoreTicket = 0;
+        setEnabled(true);
+
+        if (!ok) {
+            setInfoLabel(savedLastmod);
+            warn(this, "Pesanan gagal dipulihkan dari arsip.");
+            return;
+        }
+
+        // Lines whose ids were taken while the order was archived got new ones, so everything is read again.
+        model->archived = false;
+        loadHeader();
+        model->load();
+        savedHeader = currentHeader();
+        updateReadOnly();
+        emit restored(id);
+        return;
+    }
+
+    if (ticket == removeTicket) {
+        removeTicket = 0;
+        setEnabled(true);
+
+        if (!ok) {
+            warn(this, "Pesanan gagal dihapus.");
+            return;
+        }
+
+        ProductCatalog::instance()->updateStock(result.value("stock").toList());
+        emit removed(id);
+        return;
+    }
+
+    if (ticket != saveTicket)
+        return;
+
+    saveTicket = 0;
+    setEnabled(true);
+
+    if (!ok) {
+        printAfterSave = false;
+        infoLabel->setText("Gagal menyimpan");
+        emit saveFailed(id);
+        warn(this, "Pesanan gagal disimpan.");
+        return;
+    }
 
     bool emitAddedSignal = false;
     if (!id) {
-        id = q.lastInsertId().toLongLong();
+        id = result.value("id").toLongLong();
+        model->orderId = id;
         idEdit->setText(QString::number(id));
-        updateWindowTitle();
         emitAddedSignal = true;
     }
 
-    model->save();
+    model->markSaved(result);
 
-    if (!db.commit())
-        db.rollback();
+    if (result.contains("customerId")) {
+        CustomerDirectory::Customer customer;
+        customer.id = result.value("customerId").toLongLong();
+        customer.name = pendingHeader.customerName;
+        customer.contact = pendingHeader.customerContact;
+        customer.address = pendingHeader.customerAddress;
+        CustomerDirectory::instance()->update(customer);
+    }
 
-    setInfoLabel(now);
+    savedHeader = pendingHeader;
+    savedLastmod = pendingSaveTime;
+    setInfoLabel(pendingSaveTime);
     updateWindowTitle();
 
     if (emitAddedSignal)
         emit added(id);
 
     emit saved(id);
+
+    if (printAfterSave) {
+        printAfterSave = false;
+        printOrder();
+    }
 }
 
 void SalesOrderEditor::remove()
 {
+    if (model->archived || saveTicket || removeTicket || restoreTicket)
+        return;
+
     if (QMessageBox::question(0, "Konfirmasi", QString("Hapus transaksi nomor %1?").arg(id), "&Ya", "&Tidak"))
         return;
 
-    QSqlDatabase db = QSqlDatabase::database();
-    db.transaction();
+    const qlonglong orderId = id;
+    removeTicket = WriteQueue::instance()->submit([orderId](QSqlDatabase& db, QVariantMap& result) {
+        PreparedQuery deleteOrder("delete from sales_orders where id=?", db);
+        deleteOrder->bindValue(0, orderId);
+        if (!deleteOrder->exec())
+            return false;
+
+        PreparedQuery deleteDetails("delete from sales_order_details where parent_id=?", db);
+        deleteDetails->bindValue(0, orderId);
+        if (!deleteDetails->exec())
+            return false;
+
+        // Returns everything the order took from stock.
+        QVariantList balances;
+        if (!StockLedger::postOrder(db, orderId, balances))
+            return false;
+
+        result.insert("stock", balances);
+        return true;
+    });
 
-    QSqlQuery q(db);
-    q.prepare("delete from sales_orders where id=?");
-    q.bindValue(0, id);
-    q.exec();
+    setEnabled(false);
+}
 
-    q.prepare("delete from sales_order_details where parent_id=?");
-    q.bindValue(0, id);
-    q.exec();
+// Archived orders are opened read-only; only an edit brings one back into the hot database.
+void SalesOrderEditor::restore()
+{
+    if (!model->archived || restoreTicket)
+        return;
 
-    db.commit();
+    restoreTicket = WriteQueue::instance()->submit(Archiver::restoreJob(id));
 
-    emit removed(id);
+    setEnabled(false);
+    infoLabel->setText("Memulihkan dari arsip...");
+}
+
+void SalesOrderEditor::closeEvent(QCloseEvent* event)
+{
+    if (saveTicket || removeTicket || restoreTicket) {
+        event->ignore();
+        return;
+    }
+
+    QWidget::closeEvent(event);
 }
 
 void SalesOrderEditor::updateTotal()
@@ -662,6 +1368,9 @@ void SalesOrderEditor::updateTotal()
 
 void SalesOrderEditor::removeCurrentItem()
 {
+    if (model->archived)
+        return;
+
     QModelIndexList indexes = view->selectionModel()->selectedIndexes();
     if (indexes.isEmpty())
         return;
@@ -671,24 +1380,173 @@ void SalesOrderEditor::removeCurrentItem()
     if (row == model->rowCount() - 1)
         return;
 
-    if (confirm(this, QString("Hapus produk <b>%1</b>?").arg(model->items[row].name)))
+    if (confirm(this, QString("Hapus produk <b>%1</b>?").arg(model->items.at(row).name)))
         return;
 
     model->removeRow(row);
 }
 
+void SalesOrderEditor::editCurrentProduct()
+{
+    QModelIndexList indexes = view->selectionModel()->selectedIndexes();
+    if (indexes.isEmpty())
+        return;
+
+    int row = indexes.first().row();
+
+    if (row == model->rowCount() - 1)
+        return;
+
+    const ProductCatalog* catalog = ProductCatalog::instance();
+    const int productIndex = catalog->indexOfName(model->items.at(row).name);
+    if (productIndex < 0) {
+        warn(this, QString("Produk <b>%1</b> belum ada di katalog, simpan pesanan terlebih dahulu.")
+             .arg(model->items.at(row).name.toHtmlEscaped()));
+        return;
+    }
+
+    ProductDialog dialog(catalog->at(productIndex), this);
+    dialog.exec();
+}
+
+void SalesOrderEditor::pasteItems()
+{
+    if (model->archived)
+        return;
+
+    QLocale locale;
+    QList<Model::Item> items;
+
+    // Rows follow the visible column order: name, cost, quantity, price.
+    for (const QString& line: QApplication::clipboard()->text().split('\n', QString::SkipEmptyParts)) {
+        const QStringList fields = line.split('\t');
+        const QString name = fields.value(0).trimmed();
+        if (name.isEmpty())
+            continue;
+
+        Model::Item item;
+        const int productIndex = ProductCatalog::instance()->find(name);
+        if (productIndex >= 0) {
+            const ProductCatalog::Product& product = ProductCatalog::instance()->at(productIndex);
+            item.name = product.name;
+            item.cost = product.cost;
+            item.price = product.price;
+        }
+        else
+            item.name = name;
+
+        bool ok;
+        double cost = locale.toDouble(fields.value(1).trimmed(), &ok);
+        if (ok)
+            item.cost = cost;
+        int quantity = locale.toInt(fields.value(2).trimmed(), &ok);
+        item.quantity = ok ? quantity : 1;
+        double price = locale.toDouble(fields.value(3).trimmed(), &ok);
+        if (ok)
+            item.price = price;
+
+        items.append(item);
+    }
+
+    model->appendItems(items);
+}
+
+bool SalesOrderEditor::eventFilter(QObject* object, QEvent* event)
+{
+    if (object != view || event->type() != QEvent::KeyPress || replayingKeys || model->archived)
+        return QWidget::eventFilter(object, event);
+
+    // Keyboard-wedge scanners type a whole barcode within a few milliseconds and finish with Enter.
+    QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+    const bool fast = bufferedKeys.isEmpty() || scanKeyClock.elapsed() < ScanKeyInterval;
+    const QString text = keyEvent->text();
+
+    if ((keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter) && !bufferedKeys.isEmpty()) {
+        if (fast && bufferedKeys.size() >= MinBarcodeLength) {
+            QString code;
+            for (const BufferedKey& key: bufferedKeys)
+                code.append(key.text);
+            bufferedKeys.clear();
+            scanKeyTimer->stop();
+
+            pendingScans.append(code);
+            scanFlushTimer->start();
+            return true;
+        }
+    }
+
+    const bool printable = text.size() == 1 && text.at(0).isPrint()
+            && !(keyEvent->modifiers() & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier));
+
+    if (!printable && bufferedKeys.isEmpty())
+        return false;
+
+    BufferedKey key;
+    key.key = keyEvent->key();
+    key.modifiers = keyEvent->modifiers();
+    key.text = text;
+    bufferedKeys.append(key);
+    scanKeyClock.start();
+
+    if (printable && fast)
+        scanKeyTimer->start();
+    else
+        replayKeys();
+
+    return true;
+}
+
+void SalesOrderEditor::replayKeys()
+{
+    scanKeyTimer->stop();
+
+    const QList<BufferedKey> keys = bufferedKeys;
+    bufferedKeys.clear();
+
+    // Typed by hand after all: hand the keys back so the view opens its editor as usual.
+    replayingKeys = true;
+    for (const BufferedKey& key: keys) {
+        QKeyEvent event(QEvent::KeyPress, key.key, key.modifiers, key.text);
+        QWidget* target = QApplication::focusWidget();
+        QApplication::sendEvent(target && isAncestorOf(target) ? target : view, &event);
+    }
+    replayingKeys = false;
+}
+
+void SalesOrderEditor::flushScans()
+{
+    if (pendingScans.isEmpty())
+        return;
+
+    model->addScans(pendingScans);
+    pendingScans.clear();
+    view->scrollToBottom();
+}
+
 void SalesOrderEditor::setInfoLabel(const QDateTime& lastmod)
 {
-    infoLabel->setText(QString("Terakhir disimpan pada hari %1.").arg(lastmod.toString("dddd, dd MMMM yyyy hh:mm:ss")));
+    const QString text = QString("Terakhir disimpan pada hari %1.").arg(lastmod.toString("dddd, dd MMMM yyyy hh:mm:ss"));
+    infoLabel->setText(model->archived ? QString("Diarsipkan. %1 Ketuk <b>Ctrl+E</b> untuk mengubah.").arg(text) : text);
 }
 
 void SalesOrderEditor::saveAndPrint()
 {
+    StallScope scope("SalesOrderEditor::saveAndPrint");
     if (confirm(this, "Simpan dan cetak pesanan?"))
         return;
 
-    save();
+    if (!submitSave())
+        return;
+
+    if (saveTicket)
+        printAfterSave = true;
+    else
+        printOrder();
+}
 
+void SalesOrderEditor::printOrder()
+{
+    StallScope scope("SalesOrderEditor::printOrder");
     QPrintDialog dialog(this);
     if (!dialog.exec())
         return;
@@ -707,8 +1565,9 @@ void SalesOrderEditor::print(QPrinter *printer)
 {
     QLocale locale;
     QStringList rows;
+    model->fetchAll();
     for (int i = 0; i < model->items.size(); i++) {
-            const Model::Item item = model->items.at(i);
+            const Model::Item& item = model->items.at(i);
             rows << QString(
                         "<tr>"
                         "<td align=right>%1</td>"
@@ -2,6 +2,10 @@
 #define SALESORDEREDITOR_H
 
 #include <QWidget>
+#include <QDateTime>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QStringList>
 
 class QLabel;
 class QTableView;
@@ -9,6 +13,11 @@ class QDateTimeEdit;
 class QComboBox;
 class QLineEdit;
 class QPrinter;
+class QCloseEvent;
+class QTimer;
+class QModelIndex;
+class QSqlDatabase;
+class QAction;
 
 class SalesOrderEditor : public QWidget
 {
@@ -17,27 +26,69 @@ public:
     class Model;
     class Delegate;
     class ProductModel;
-    SalesOrderEditor(qlonglong id, QWidget* parent);
+    SalesOrderEditor(qlonglong id, QWidget* parent, bool archived = false);
+
+    // Lays the order out on a printer that is already set up.
+    void print(QPrinter* printer);
 
 signals:
     void added(qlonglong id);
     void saved(qlonglong id);
+    void saveFailed(qlonglong id);
     void removed(qlonglong id);
+    void restored(qlonglong id);
     void closeRequest();
 
 public slots:
     void init();
+    void refresh();
     void save();
     void remove();
+    void restore();
     void removeCurrentItem();
     void saveAndPrint();
     void updateTotal();
 
+private slots:
+    void onWriteFinished(int ticket, bool ok, const QVariantMap& result);
+    void pasteItems();
+    void editCurrentProduct();
+    void replayKeys();
+    void flushScans();
+    void fillCustomer(const QModelIndex& index);
+
 public:
     qlonglong id;
 
+protected:
+    void closeEvent(QCloseEvent* event);
+    bool eventFilter(QObject* object, QEvent* event);
+
 private:
-    void print(QPrinter* printer);
+    struct Header
+    {
+        QDateTime openDateTime;
+        int state;
+        QString customerName;
+        QString customerContact;
+        QString customerAddress;
+        double grandTotal;
+    };
+
+    struct BufferedKey
+    {
+        int key;
+        Qt::KeyboardModifiers modifiers;
+        QString text;
+    };
+
+    Header currentHeader() const;
+    bool loadHeader();
+    void setupCustomerCompleter(QLineEdit* edit, int field);
+    static bool saveCustomer(QSqlDatabase& db, const Header& header, QVariantMap& result);
+    bool submitSave();
+    void printOrder();
+    void updateReadOnly();
     void updateWindowTitle();
     void setInfoLabel(const QDateTime& lastmod);
 
@@ -50,9 +101,27 @@ private:
     QDateTimeEdit* openDateTimeEdit;
     QComboBox* stateComboBox;
     QLineEdit* totalEdit;
+    QAction* saveAction;
+    QAction* removeAction;
+    QAction* restoreAction;
 
     Model* model;
     Delegate* delegate;
+    Header savedHeader;
+    Header pendingHeader;
+    QDateTime savedLastmod;
+    QDateTime pendingSaveTime;
+    int saveTicket;
+    int removeTicket;
+    int restoreTicket;
+    bool printAfterSave;
+
+    QTimer* scanKeyTimer;
+    QTimer* scanFlushTimer;
+    QElapsedTimer scanKeyClock;
+    QList<BufferedKey> bufferedKeys;
+    QStringList pendingScans;
+    bool replayingKeys;
 };
 
 #endif // SALESORDEREDITOR_H
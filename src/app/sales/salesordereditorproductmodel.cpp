@@ -1,14 +1,90 @@
 #include "salesordereditorproductmodel.h"
+#include "products/productcatalog.h"
+#include "diagnostics/memoryaccounting.h"
+
+#include <algorithm>
+
+namespace {
+
+bool nameLessThan(int a, int b)
+{
+    const ProductCatalog* catalog = ProductCatalog::instance();
+    return QString::compare(catalog->at(a).name, catalog->at(b).name, Qt::CaseInsensitive) < 0;
+}
+
+}
 
 SalesOrderEditor::ProductModel* SalesOrderEditor::ProductModel::self = 0;
 
 SalesOrderEditor::ProductModel::ProductModel(QObject*parent)
-    : QSqlQueryModel(parent)
+    : QAbstractListModel(parent)
 {
     self = this;
+
+    ProductCatalog* catalog = ProductCatalog::instance();
+    connect(catalog, SIGNAL(reloaded()), SLOT(onReloaded()));
+    connect(catalog, SIGNAL(productAdded(int)), SLOT(onProductAdded(int)));
+    connect(catalog, SIGNAL(productChanged(int)), SLOT(onProductChanged(int)));
+    onReloaded();
+
+    MemoryAccounting::track(this, "SalesOrderEditor::ProductModel", [this]() { return MemoryUsage::of(order); });
+}
+
+int SalesOrderEditor::ProductModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : order.size();
+}
+
+QVariant SalesOrderEditor::ProductModel::data(const QModelIndex& index, int role) const
+{
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+        return ProductCatalog::instance()->at(order.at(index.row())).name;
+
+    return QVariant();
 }
 
 void SalesOrderEditor::ProductModel::refresh()
 {
-    setQuery("select name from products order by name asc");
+    ProductCatalog::instance()->reload();
+}
+
+void SalesOrderEditor::ProductModel::onReloaded()
+{
+    beginResetModel();
+    order.resize(ProductCatalog::instance()->count());
+    for (int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), nameLessThan);
+    endResetModel();
+}
+
+void SalesOrderEditor::ProductModel::onProductAdded(int index)
+{
+    const int row = std::lower_bound(order.begin(), order.end(), index, nameLessThan) - order.begin();
+    beginInsertRows(QModelIndex(), row, row);
+    order.insert(row, index);
+    endInsertRows();
+}
+
+void SalesOrderEditor::ProductModel::onProductChanged(int index)
+{
+    const int row = order.indexOf(index);
+    if (row < 0)
+        return;
+
+    // A renamed product that no longer sorts between its neighbours is taken out and put back in its new
+    // place, so that the completer's prefix lookups keep working on a sorted list.
+    const bool sorted = (row == 0 || !nameLessThan(index, order.at(row - 1)))
+            && (row == order.size() - 1 || !nameLessThan(order.at(row + 1), index));
+    if (sorted) {
+        const QModelIndex modelIndex = this->index(row);
+        emit dataChanged(modelIndex, modelIndex);
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), row, row);
+    order.remove(row);
+    endRemoveRows();
+
+    onProductAdded(index);
 }
@@ -1,10 +1,11 @@
 #ifndef SALESORDEREDITORPRODUCTMODEL_H
 #define SALESORDEREDITORPRODUCTMODEL_H
 
-#include <QSqlQueryModel>
+#include <QAbstractListModel>
+#include <QVector>
 #include "salesordereditor.h"
 
-class SalesOrderEditor::ProductModel : public QSqlQueryModel
+class SalesOrderEditor::ProductModel : public QAbstractListModel
 {
     Q_OBJECT
 public:
@@ -12,11 +13,21 @@ public:
 
     static inline ProductModel* instance() { return self; }
 
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
 public slots:
     void refresh();
 
+private slots:
+    void onReloaded();
+    void onProductAdded(int index);
+    void onProductChanged(int index);
+
 private:
     static ProductModel* self;
+
+    QVector<int> order;
 };
 
 #endif // SALESORDEREDITORPRODUCTMODEL_H
@@ -2,6 +2,14 @@
 #include "salesordereditor.h"
 #include "salesordermodel.h"
 #include "salesorderproxymodel.h"
+#include "salesorderdelegate.h"
+#include "db/archiver.h"
+#include "analytics/analyticswidget.h"
+#include "db/writequeue.h"
+#include "db/preparedquery.h"
+#include "products/productcatalog.h"
+#include "stock/stockledger.h"
+#include "diagnostics/stalldetector.h"
 
 #include <QTimer>
 #include <QTabWidget>
@@ -12,10 +20,33 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QComboBox>
+#include <QDateEdit>
 #include <QPushButton>
+#include <QSettings>
+#include <QInputDialog>
+#include <QLocale>
+#include <QMessageBox>
+#include <QDateTime>
+
+namespace {
+
+// Lists longer than this are painted by the lightweight delegate.
+const int HighVolumeThreshold = 5000;
+
+// Rows measured when fitting column widths to their contents.
+const int ColumnWidthSampleRows = 200;
+
+// Values of sales_orders.state that the bulk actions set.
+const int CompletedState = 1;
+const int CancelledState = 2;
+
+}
 
 SalesOrderManager::SalesOrderManager(QWidget* parent)
     : QSplitter(parent)
+    , analyticsWidget(0)
+    , bulkTicket(0)
+    , stockTicket(0)
 {
     model = new SalesOrderModel(this);
     proxyModel = new SalesOrderProxyModel(this);
@@ -36,6 +67,26 @@ SalesOrderManager::SalesOrderManager(QWidget* parent)
     newAction->setShortcut(QKeySequence("Ctrl+N"));
     newAction->setToolTip(actionTooltip.arg("Pesanan baru").arg(newAction->shortcut().toString()));
 
+    toolBar->addSeparator();
+
+    completeAction = toolBar->addAction(QIcon(":/resources/icons/ok.png"), "&Selesaikan", this, SLOT(completeSelected()));
+    completeAction->setToolTip("Tandai pesanan yang dipilih sebagai selesai");
+
+    cancelAction = toolBar->addAction(QIcon(":/resources/icons/ban.png"), "Bata&lkan", this, SLOT(cancelSelected()));
+    cancelAction->setToolTip("Batalkan pesanan yang dipilih");
+
+    removeAction = toolBar->addAction(QIcon(":/resources/icons/remove.png"), "&Hapus", this, SLOT(removeSelected()));
+    removeAction->setToolTip("Hapus pesanan yang dipilih");
+
+    toolBar->addSeparator();
+
+    QAction* analyticsAction = toolBar->addAction(QIcon(":/resources/icons/information.png"), "&Analitik", this, SLOT(openAnalytics()));
+    analyticsAction->setShortcut(QKeySequence("Ctrl+Shift+A"));
+    analyticsAction->setToolTip(actionTooltip.arg("Analitik penjualan").arg(analyticsAction->shortcut().toString()));
+
+    QAction* stockAction = toolBar->addAction(QIcon(":/resources/icons/settings.png"), "&Stok", this, SLOT(adjustStock()));
+    stockAction->setToolTip("Catat penerimaan atau penyesuaian stok produk");
+
     QAction* closeTabAction = new QAction(this);
     closeTabAction->setShortcuts(QList<QKeySequence>({QKeySequence("Esc"), QKeySequence("Ctrl+W")}));
     addAction(closeTabAction);
@@ -59,6 +110,33 @@ SalesOrderManager::SalesOrderManager(QWidget* parent)
     stateComboBox->setCurrentIndex(1);
     toolBar->addWidget(stateComboBox);
 
+    periodComboBox = new QComboBox(toolBar);
+    periodComboBox->setToolTip("Saring daftar pesanan berdasarkan tanggal");
+    periodComboBox->addItem("Semua Tanggal");
+    periodComboBox->addItem("Hari Ini");
+    periodComboBox->addItem("Minggu Ini");
+    periodComboBox->addItem("Bulan Ini");
+    periodComboBox->addItem("Rentang Tanggal");
+    toolBar->addWidget(periodComboBox);
+
+    fromDateEdit = new QDateEdit(QDate::currentDate(), toolBar);
+    fromDateEdit->setToolTip("Dari tanggal");
+    fromDateEdit->setCalendarPopup(true);
+    fromDateEdit->setDisplayFormat("dd/MM/yyyy");
+    toolBar->addWidget(fromDateEdit);
+
+    toDateEdit = new QDateEdit(QDate::currentDate(), toolBar);
+    toDateEdit->setToolTip("Sampai tanggal");
+    toDateEdit->setCalendarPopup(true);
+    toDateEdit->setDisplayFormat("dd/MM/yyyy");
+    toolBar->addWidget(toDateEdit);
+
+    searchModeComboBox = new QComboBox(toolBar);
+    searchModeComboBox->setToolTip("Cari berdasarkan data pesanan atau nama produk yang dipesan");
+    searchModeComboBox->addItem("Pesanan");
+    searchModeComboBox->addItem("Produk");
+    toolBar->addWidget(searchModeComboBox);
+
     searchEdit = new QLineEdit(toolBar);
     searchEdit->setToolTip("Cari di daftar pesanan");
     searchEdit->setPlaceholderText("Cari");
@@ -72,7 +150,7 @@ SalesOrderManager::SalesOrderManager(QWidget* parent)
     view->setModel(proxyModel);
     view->setAlternatingRowColors(true);
     view->setSortingEnabled(true);
-    view->setSelectionMode(QAbstractItemView::SingleSelection);
+    view->setSelectionMode(QAbstractItemView::ExtendedSelection);
     view->setSelectionBehavior(QAbstractItemView::SelectRows);
     view->setTabKeyNavigation(false);
     QHeaderView* header = view->verticalHeader();
@@ -80,9 +158,15 @@ SalesOrderManager::SalesOrderManager(QWidget* parent)
     header->setMinimumSectionSize(20);
     header->setMaximumSectionSize(20);
     header->setDefaultSectionSize(20);
+    header->setSectionResizeMode(QHeaderView::Fixed);
     header = view->horizontalHeader();
     header->setToolTip("Klik pada header kolom untuk mengurutkan");
     header->setHighlightSections(false);
+    header->setResizeContentsPrecision(ColumnWidthSampleRows);
+    header->setStretchLastSection(true);
+
+    defaultDelegate = view->itemDelegate();
+    highVolumeDelegate = new SalesOrderDelegate(proxyModel, view);
 
     containerLayout->addWidget(view);
 
@@ -104,65 +188,379 @@ SalesOrderManager::SalesOrderManager(QWidget* parent)
     connect(closeAllTabsAction, SIGNAL(triggered(bool)), SLOT(closeAllTabs()));
     connect(tabWidget, SIGNAL(tabCloseRequested(int)), SLOT(closeTab(int)));
     connect(stateComboBox, SIGNAL(currentIndexChanged(int)), SLOT(refresh()));
+    connect(periodComboBox, SIGNAL(activated(int)), SLOT(refresh()));
+    connect(fromDateEdit, SIGNAL(dateChanged(QDate)), SLOT(onDateEdited()));
+    connect(toDateEdit, SIGNAL(dateChanged(QDate)), SLOT(onDateEdited()));
+    connect(searchModeComboBox, SIGNAL(currentIndexChanged(int)), SLOT(refresh()));
     connect(searchEdit, SIGNAL(textChanged(QString)), SLOT(applyFilter()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(updateInfo()));
     connect(view, SIGNAL(activated(QModelIndex)), SLOT(edit()));
+    connect(view->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), SLOT(updateBulkActions()));
+    connect(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)), SLOT(onWriteFinished(int,bool,QVariantMap)));
+
+    updateBulkActions();
 
     QTimer::singleShot(0, this, SLOT(init()));
 }
 
+SalesOrderManager::~SalesOrderManager()
+{
+    QSettings settings;
+    settings.setValue("salesOrderManager/header", view->horizontalHeader()->saveState());
+    settings.setValue("salesOrderManager/period", periodComboBox->currentIndex());
+    settings.setValue("salesOrderManager/fromDate", fromDateEdit->date());
+    settings.setValue("salesOrderManager/toDate", toDateEdit->date());
+}
+
 void SalesOrderManager::init()
 {
+    QSettings settings;
+    QHeaderView* header = view->horizontalHeader();
+    const bool restored = header->restoreState(settings.value("salesOrderManager/header").toByteArray());
+
+    periodComboBox->setCurrentIndex(settings.value("salesOrderManager/period", AllDates).toInt());
+    if (periodComboBox->currentIndex() == CustomPeriod) {
+        fromDateEdit->blockSignals(true);
+        toDateEdit->blockSignals(true);
+        fromDateEdit->setDate(settings.value("salesOrderManager/fromDate", QDate::currentDate()).toDate());
+        toDateEdit->setDate(settings.value("salesOrderManager/toDate", QDate::currentDate()).toDate());
+        fromDateEdit->blockSignals(false);
+        toDateEdit->blockSignals(false);
+    }
+
     refresh();
-    view->sortByColumn(0, Qt::AscendingOrder);
+
+    if (restored)
+        view->sortByColumn(header->sortIndicatorSection(), header->sortIndicatorOrder());
+    else {
+        view->resizeColumnsToContents();
+        view->sortByColumn(0, Qt::AscendingOrder);
+    }
 }
 
 void SalesOrderManager::refresh()
 {
+    StallScope scope("SalesOrderManager::refresh");
     int state = stateComboBox->currentIndex() - 1;
+    QHeaderView* header = view->horizontalHeader();
+
+    if (!model->isServerSide())
+        model->sort(header->sortIndicatorSection(), header->sortIndicatorOrder());
+    model->setProductSearch(searchModeComboBox->currentIndex() == ProductSearch);
+    searchEdit->setPlaceholderText(model->isProductSearch() ? "Cari produk" : "Cari");
+    model->setSearchText(searchEdit->text().trimmed());
+
+    updatePeriodDates();
+    if (periodComboBox->currentIndex() == AllDates)
+        model->setDateRange(QDate(), QDate());
+    else
+        model->setDateRange(fromDateEdit->date(), toDateEdit->date());
 
     model->refreshAll(state);
+
+    // Large lists are sorted, filtered and windowed by SQLite, bypassing the proxy entirely.
+    // Switching models replaces the view's selection model.
+    if (model->isServerSide() && view->model() != model) {
+        view->setModel(model);
+        proxyModel->setSourceModel(0);
+        connect(view->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), SLOT(updateBulkActions()));
+    }
+    else if (!model->isServerSide() && view->model() != proxyModel) {
+        proxyModel->setSourceModel(model);
+        view->setModel(proxyModel);
+        view->sortByColumn(header->sortIndicatorSection(), header->sortIndicatorOrder());
+        connect(view->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), SLOT(updateBulkActions()));
+    }
+
+    // The cached cells must follow whichever model the view now shows.
+    highVolumeDelegate->setModel(view->model());
+
+    view->setColumnHidden(SalesOrderModel::HitsColumn, !model->isProductSearch());
+
     applyFilter();
 
-    view->resizeColumnsToContents();
-    view->horizontalHeader()->setStretchLastSection(true);
+    if (model->totalCount() > HighVolumeThreshold) {
+        if (view->itemDelegate() != highVolumeDelegate)
+            view->setItemDelegate(highVolumeDelegate);
+    }
+    else if (view->itemDelegate() != defaultDelegate)
+        view->setItemDelegate(defaultDelegate);
+}
+
+void SalesOrderManager::invalidate(const QList<qlonglong>& ids)
+{
+    model->invalidate(ids);
+
+    for (qlonglong id: ids) {
+        if (SalesOrderEditor* editor = editorById.value(id))
+            editor->refresh();
+    }
+}
+
+void SalesOrderManager::updatePeriodDates()
+{
+    // Presets are recomputed on every refresh so that "today" follows the clock past midnight.
+    const QDate today = QDate::currentDate();
+    QDate from = fromDateEdit->date();
+    QDate to = toDateEdit->date();
+
+    switch (periodComboBox->currentIndex()) {
+    case Today:
+        from = to = today;
+        break;
+    case ThisWeek:
+        from = today.addDays(1 - today.dayOfWeek());
+        to = from.addDays(6);
+        break;
+    case ThisMonth:
+        from = QDate(today.year(), today.month(), 1);
+        to = from.addMonths(1).addDays(-1);
+        break;
+    }
+
+    fromDateEdit->blockSignals(true);
+    toDateEdit->blockSignals(true);
+    fromDateEdit->setDate(from);
+    toDateEdit->setDate(to);
+    fromDateEdit->blockSignals(false);
+    toDateEdit->blockSignals(false);
+
+    const bool ranged = periodComboBox->currentIndex() != AllDates;
+    fromDateEdit->setEnabled(ranged);
+    toDateEdit->setEnabled(ranged);
+}
+
+void SalesOrderManager::onDateEdited()
+{
+    periodComboBox->setCurrentIndex(CustomPeriod);
+    refresh();
 }
 
 void SalesOrderManager::applyFilter()
 {
+    StallScope scope("SalesOrderManager::applyFilter");
     QString query = searchEdit->text().trimmed();
-    if (query.isEmpty())
+    if (model->isProductSearch()) {
+        proxyModel->setFilterFixedString(QString());
+        model->setSearchText(query);
+    }
+    else if (model->isServerSide())
+        model->setSearchText(query);
+    else if (query.isEmpty())
         proxyModel->setFilterFixedString(query);
     else
         proxyModel->setFilterWildcard("*" + query + "*");
 
+    updateInfo();
+}
+
+void SalesOrderManager::updateInfo()
+{
+    const int total = model->totalCount();
+    const int shown = model->isServerSide() ? model->rowCount() : proxyModel->rowCount();
+
     QString info;
-    if (model->rowCount() == 0)
+    if (total == 0)
         info = "Tidak ada rekaman yang dapat ditampilkan";
-    else if (model->rowCount() == proxyModel->rowCount())
-        info = QString("Menampilkan %1 rekaman").arg(model->rowCount());
+    else if (total == shown)
+        info = QString("Menampilkan %1 rekaman").arg(total);
     else
-        info = QString("Menampilkan %1 rekaman disaring dari total %2 rekaman").arg(proxyModel->rowCount()).arg(model->rowCount());
+        info = QString("Menampilkan %1 rekaman disaring dari total %2 rekaman").arg(shown).arg(total);
 
     infoLabel->setText(info);
 }
 
 void SalesOrderManager::edit()
 {
-    openEditor(view->selectionModel()->selectedRows(SalesOrderModel::IdColumn).first().data(Qt::EditRole).toLongLong());
+    const QModelIndex current = view->currentIndex();
+    if (!current.isValid())
+        return;
+
+    openEditor(current.sibling(current.row(), SalesOrderModel::IdColumn).data(Qt::EditRole).toLongLong());
+}
+
+QList<qlonglong> SalesOrderManager::selectedIds() const
+{
+    QList<qlonglong> ids;
+    for (const QModelIndex& index: view->selectionModel()->selectedRows(SalesOrderModel::IdColumn))
+        ids.append(index.data(Qt::EditRole).toLongLong());
+    return ids;
+}
+
+void SalesOrderManager::updateBulkActions()
+{
+    const bool enabled = !bulkTicket && view->selectionModel()->hasSelection();
+    completeAction->setEnabled(enabled);
+    cancelAction->setEnabled(enabled);
+    removeAction->setEnabled(enabled);
+}
+
+void SalesOrderManager::completeSelected()
+{
+    const QList<qlonglong> ids = selectedIds();
+    if (ids.isEmpty() || QMessageBox::question(0, "Konfirmasi", QString("Tandai %1 pesanan sebagai selesai?").arg(ids.size()), "&Ya", "&Tidak"))
+        return;
+
+    submitBulk(ids, CompleteOrders);
+}
+
+void SalesOrderManager::cancelSelected()
+{
+    const QList<qlonglong> ids = selectedIds();
+    if (ids.isEmpty() || QMessageBox::question(0, "Konfirmasi", QString("Batalkan %1 pesanan?").arg(ids.size()), "&Ya", "&Tidak"))
+        return;
+
+    submitBulk(ids, CancelOrders);
+}
+
+void SalesOrderManager::removeSelected()
+{
+    QList<qlonglong> ids = selectedIds();
+    if (ids.isEmpty() || QMessageBox::question(0, "Konfirmasi", QString("Hapus %1 pesanan?").arg(ids.size()), "&Ya", "&Tidak"))
+        return;
+
+    // Orders whose editor refuses to close, because it is still saving, are left alone.
+    for (int i = ids.size() - 1; i >= 0; i--) {
+        if (SalesOrderEditor* editor = editorById.value(ids.at(i))) {
+            closeTab(tabWidget->indexOf(editor));
+            if (editorById.contains(ids.at(i)))
+                ids.removeAt(i);
+        }
+    }
+
+    submitBulk(ids, RemoveOrders);
+}
+
+void SalesOrderManager::submitBulk(const QList<qlonglong>& ids, BulkAction action)
+{
+    if (ids.isEmpty() || bulkTicket)
+        return;
+
+    bulkIds = ids;
+    bulkTicket = WriteQueue::instance()->submit(bulkJob(ids, action, QDateTime::currentDateTime()));
+
+    setCursor(Qt::BusyCursor);
+    updateBulkActions();
+}
+
+// The selection goes into a temp table once; every statement after that works on the whole set.
+WriteQueue::Job SalesOrderManager::bulkJob(const QList<qlonglong>& ids, BulkAction action, const QDateTime& now)
+{
+    return [ids, action, now](QSqlDatabase& db, QVariantMap& result) {
+        // Statements on the temp table are prepared only once it exists.
+        PreparedQuery create("create temp table if not exists bulk_order_ids (id integer primary key)", db);
+        if (!create->exec())
+            return false;
+
+        PreparedQuery clear("delete from temp.bulk_order_ids", db);
+        if (!clear->exec())
+            return false;
+
+        PreparedQuery insert("insert or ignore into temp.bulk_order_ids (id) values (?)", db);
+        for (qlonglong id: ids) {
+            insert->bindValue(0, id);
+            if (!insert->exec())
+                return false;
+        }
+
+        // Archived orders are listed but live in another database; they are left untouched. Their stock
+        // movements stay in the hot database, so they must not reach the ledger either.
+        QVariantList skipped;
+        PreparedQuery archived("select id from temp.bulk_order_ids where id not in (select id from main.sales_orders)", db);
+        if (!archived->exec())
+            return false;
+        while (archived->next())
+            skipped.append(archived->value(0));
+        result.insert("skipped", skipped);
+
+        PreparedQuery skip("delete from temp.bulk_order_ids where id not in (select id from main.sales_orders)", db);
+        if (!skip->exec())
+            return false;
+
+        if (action == RemoveOrders) {
+            PreparedQuery details("delete from sales_order_details where parent_id in (select id from temp.bulk_order_ids)", db);
+            PreparedQuery orders("delete from sales_orders where id in (select id from temp.bulk_order_ids)", db);
+            if (!details->exec() || !orders->exec())
+                return false;
+        }
+        else {
+            const int state = action == CompleteOrders ? CompletedState : CancelledState;
+            PreparedQuery update("update sales_orders set state=?, lastmod_datetime=?"
+                                 " where id in (select id from temp.bulk_order_ids) and state<>?", db);
+            update->bindValue(0, state);
+            update->bindValue(1, now);
+            update->bindValue(2, state);
+            if (!update->exec())
+                return false;
+        }
+
+        QVariantList balances;
+        if (!StockLedger::postOrders(db, "select id from temp.bulk_order_ids", QVariantList(), balances))
+            return false;
+
+        result.insert("stock", balances);
+        return true;
+    };
+}
+
+void SalesOrderManager::onWriteFinished(int ticket, bool ok, const QVariantMap& result)
+{
+    if (ticket == stockTicket) {
+        stockTicket = 0;
+        if (ok)
+            ProductCatalog::instance()->updateStock(result.value("stock").toList());
+        else
+            QMessageBox::warning(this, "Peringatan", "Penyesuaian stok gagal disimpan.");
+        return;
+    }
+
+    if (ticket != bulkTicket)
+        return;
+
+    bulkTicket = 0;
+    unsetCursor();
+    updateBulkActions();
+
+    QList<qlonglong> ids = bulkIds;
+    bulkIds.clear();
+
+    if (!ok) {
+        QMessageBox::warning(this, "Peringatan", "Perubahan pesanan yang dipilih gagal disimpan.");
+        return;
+    }
+
+    ProductCatalog::instance()->updateStock(result.value("stock").toList());
+
+    const QVariantList skipped = result.value("skipped").toList();
+    for (const QVariant& id: skipped)
+        ids.removeOne(id.toLongLong());
+
+    if (!skipped.isEmpty())
+        QMessageBox::information(this, "Informasi", QString("%1 pesanan arsip tidak diubah.").arg(skipped.size()));
+
+    // One batched model update for the whole set; open editors of changed orders reload themselves.
+    model->refresh(ids);
+    for (qlonglong id: ids) {
+        if (SalesOrderEditor* editor = editorById.value(id))
+            editor->refresh();
+    }
 }
 
 void SalesOrderManager::openEditor(qlonglong id)
 {
+    StallScope scope("SalesOrderManager::openEditor");
     SalesOrderEditor* editor = 0;
 
     if (id > 0)
         editor = editorById.value(id);
 
     if (!editor) {
-        editor = new SalesOrderEditor(id, tabWidget);
+        // Archived orders open read-only from the archive; the editor restores one only to change it.
+        editor = new SalesOrderEditor(id, tabWidget, id > 0 && Archiver::contains(id));
         connect(editor, SIGNAL(added(qlonglong)), SLOT(onAdded(qlonglong)));
         connect(editor, SIGNAL(removed(qlonglong)), SLOT(onRemoved(qlonglong)));
         connect(editor, SIGNAL(saved(qlonglong)), SLOT(onSaved(qlonglong)));
+        connect(editor, SIGNAL(restored(qlonglong)), SLOT(onSaved(qlonglong)));
         int index = tabWidget->addTab(editor, editor->windowTitle());
         tabWidget->tabBar()->tabButton(index, QTabBar::RightSide)->setToolTip("Tutup");
 
@@ -176,18 +574,76 @@ void SalesOrderManager::openEditor(qlonglong id)
         tabWidget->show();
 }
 
+void SalesOrderManager::openAnalytics()
+{
+    if (!analyticsWidget) {
+        analyticsWidget = new AnalyticsWidget(tabWidget);
+        int index = tabWidget->addTab(analyticsWidget, analyticsWidget->windowTitle());
+        tabWidget->tabBar()->tabButton(index, QTabBar::RightSide)->setToolTip("Tutup");
+    }
+
+    tabWidget->setCurrentWidget(analyticsWidget);
+
+    if (tabWidget->isHidden())
+        tabWidget->show();
+}
+
+void SalesOrderManager::adjustStock()
+{
+    const ProductCatalog* catalog = ProductCatalog::instance();
+
+    QStringList names;
+    for (int i = 0; i < catalog->count(); i++)
+        names.append(catalog->at(i).name);
+    names.sort(Qt::CaseInsensitive);
+
+    bool ok = false;
+    const QString name = QInputDialog::getItem(this, "Penyesuaian Stok", "Produk:", names, 0, true, &ok);
+    if (!ok || name.trimmed().isEmpty())
+        return;
+
+    const int productIndex = catalog->find(name);
+    if (productIndex < 0) {
+        QMessageBox::warning(this, "Peringatan", QString("Produk %1 tidak ditemukan.").arg(name));
+        return;
+    }
+
+    const ProductCatalog::Product& product = catalog->at(productIndex);
+    const int quantity = QInputDialog::getInt(this, "Penyesuaian Stok",
+                                              QString("Stok %1 saat ini %2.\nJumlah masuk (negatif untuk mengurangi):")
+                                              .arg(product.name, QLocale().toString(product.stock)),
+                                              0, -1000000, 1000000, 1, &ok);
+    if (!ok || quantity == 0)
+        return;
+
+    // The new balance comes back with the job, for the catalog to show straight away.
+    const qlonglong productId = product.id;
+    stockTicket = WriteQueue::instance()->submit([productId, quantity](QSqlDatabase& db, QVariantMap& result) {
+        QVariantList balances;
+        if (!StockLedger::adjust(db, productId, quantity, balances))
+            return false;
+
+        result.insert("stock", balances);
+        return true;
+    });
+}
+
 void SalesOrderManager::closeTab(int index)
 {
-    SalesOrderEditor* editor = static_cast<SalesOrderEditor*>(tabWidget->widget(index));
-    if (!editor->close())
+    QWidget* widget = tabWidget->widget(index);
+    SalesOrderEditor* editor = qobject_cast<SalesOrderEditor*>(widget);
+    if (editor && !editor->close())
         return;
 
     tabWidget->removeTab(index);
 
-    if (editor->id != 0)
+    if (editor && editor->id != 0)
         editorById.remove(editor->id);
 
-    delete editor;
+    if (widget == analyticsWidget)
+        analyticsWidget = 0;
+
+    delete widget;
 
     if (tabWidget->count() == 0)
         tabWidget->hide();
@@ -214,17 +670,17 @@ void SalesOrderManager::onAdded(qlonglong id)
 
     editorById.insert(id, editor);
 
-    model->refresh(id);
+    model->invalidate(id);
 }
 
 void SalesOrderManager::onSaved(qlonglong id)
 {
-    model->refresh(id);
+    model->invalidate(id);
 }
 
 void SalesOrderManager::onRemoved(qlonglong id)
 {
     closeTab(tabWidget->indexOf(editorById.value(id)));
 
-    model->refresh(id);
+    model->invalidate(id);
 }
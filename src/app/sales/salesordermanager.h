@@ -2,30 +2,54 @@
 #define SALESORDERMANAGER_H
 
 #include <QSplitter>
+#include <QVariantMap>
+
+#include "db/writequeue.h"
 
 class QTabWidget;
 class QTableView;
 class QLineEdit;
 class QLabel;
 class QComboBox;
+class QDateEdit;
+class QAction;
 
 class SalesOrderEditor;
 class SalesOrderModel;
 class SalesOrderProxyModel;
+class SalesOrderDelegate;
+class AnalyticsWidget;
+class QAbstractItemDelegate;
 
 class SalesOrderManager : public QSplitter
 {
     Q_OBJECT
 public:
+    enum BulkAction {
+        CompleteOrders,
+        CancelOrders,
+        RemoveOrders
+    };
+
     SalesOrderManager(QWidget* parent);
+    ~SalesOrderManager();
+
+    static WriteQueue::Job bulkJob(const QList<qlonglong>& ids, BulkAction action, const QDateTime& now);
 
 public slots:
     void refresh();
+    void invalidate(const QList<qlonglong>& ids);
     void openEditor(qlonglong id = 0);
+    void openAnalytics();
+    void adjustStock();
+    void completeSelected();
+    void cancelSelected();
+    void removeSelected();
 
 private slots:
     void edit();
     void applyFilter();
+    void updateInfo();
     void init();
     void closeTab(int index);
     void closeCurrentTab();
@@ -33,18 +57,50 @@ private slots:
     void onAdded(qlonglong id);
     void onSaved(qlonglong id);
     void onRemoved(qlonglong id);
+    void onDateEdited();
+    void onWriteFinished(int ticket, bool ok, const QVariantMap& result);
+    void updateBulkActions();
 
 private:
+    enum Period {
+        AllDates,
+        Today,
+        ThisWeek,
+        ThisMonth,
+        CustomPeriod
+    };
+
+    enum SearchMode {
+        OrderSearch,
+        ProductSearch
+    };
+
+    void updatePeriodDates();
+    QList<qlonglong> selectedIds() const;
+    void submitBulk(const QList<qlonglong>& ids, BulkAction action);
 
     QTabWidget* tabWidget;
     QTableView* view;
     QLineEdit* searchEdit;
     QLabel* infoLabel;
     QComboBox* stateComboBox;
+    QComboBox* periodComboBox;
+    QComboBox* searchModeComboBox;
+    QDateEdit* fromDateEdit;
+    QDateEdit* toDateEdit;
+    QAction* completeAction;
+    QAction* cancelAction;
+    QAction* removeAction;
 
     SalesOrderProxyModel* proxyModel;
     SalesOrderModel* model;
+    SalesOrderDelegate* highVolumeDelegate;
+    QAbstractItemDelegate* defaultDelegate;
     QHash<qlonglong,SalesOrderEditor*> editorById;
+    AnalyticsWidget* analyticsWidget;
+    QList<qlonglong> bulkIds;
+    int bulkTicket;
+    int stockTicket;
 };
 
 #endif // SALESORDERMANAGER_H
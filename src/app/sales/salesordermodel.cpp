@@ -1,150 +1,739 @@
 #include "salesordermodel.h"
+#include "salesordersearch.h"
+#include "db/archiver.h"
+#include "db/preparedquery.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include <QSqlQuery>
-#include <QLocale>
+#include <QStringList>
 #include <QVariant>
 #include <QDateTime>
 #include <QColor>
+#include <QTimer>
 
-#define SELECT_COLUMNS_FROM_SALES_ORDERS \
-    "select id, state, open_datetime, grand_total, customer_name, customer_contact, customer_address "\
-    "from sales_orders"
+#include <algorithm>
+
+#define SALES_ORDER_MODEL_COLUMN_SQL_FIRST(column, member, type, sql, ...) sql
+#define SALES_ORDER_MODEL_COLUMN_SQL_NEXT(column, member, type, sql, ...) ", " sql
+#define SALES_ORDER_MODEL_COLUMN_ORDER_BY(column, member, type, sql, orderBy, ...) orderBy,
+#define SALES_ORDER_MODEL_COLUMN_READ(column, member, type, ...) item.member = q.value(column).value<type>();
+#define SALES_ORDER_MODEL_COLUMN_DESCRIPTOR(column, member, type, sql, orderBy, label, alignment, format) \
+    MEMBER_COLUMN(SalesOrderModel::Row, member, type, label, alignment, false, format),
+
+#define SELECT_SALES_ORDER_COLUMNS \
+    "select " SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_SQL_FIRST, SALES_ORDER_MODEL_COLUMN_SQL_NEXT) " "
+
+namespace {
+
+// Above this many orders sorting, filtering and windowing are left to SQLite.
+const int ServerSideThreshold = 50000;
+const int PageSize = 256;
+const int MaxCachedPages = 16;
+
+// Invalidations arriving within this window are refreshed together.
+const int InvalidateWindow = 50;
+
+// Keeps "id in (...)" lists well below SQLite's bound parameter limit.
+const int RefreshChunkSize = 500;
+
+QVariant stateText(const int& state)
+{
+    return state == 0 ? "Aktif" : (state == 1 ? "Selesai" : "Dibatalkan");
+}
+
+const char* const orderByColumns[] = {
+    SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_ORDER_BY, SALES_ORDER_MODEL_COLUMN_ORDER_BY)
+};
+
+const ColumnDescriptor<SalesOrderModel::Row> columns[] = {
+    SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_DESCRIPTOR, SALES_ORDER_MODEL_COLUMN_DESCRIPTOR)
+};
+
+static_assert(sizeof(columns) / sizeof(columns[0]) == SalesOrderModel::ColumnCount, "one descriptor per column");
+
+void bindValues(QSqlQuery& q, const QVariantList& values)
+{
+    for (int i = 0; i < values.size(); i++)
+        q.bindValue(i, values.at(i));
+}
+
+// String payload of a row, added to the running counts as rows come and go.
+qint64 rowBytes(const SalesOrderModel::Row& row)
+{
+    return MemoryUsage::of(row.customerName) + MemoryUsage::of(row.customerContact) + MemoryUsage::of(row.customerAddress);
+}
+
+qint64 rowsBytes(const QList<SalesOrderModel::Row>& rows)
+{
+    qint64 bytes = 0;
+    for (const SalesOrderModel::Row& row: rows)
+        bytes += rowBytes(row);
+    return bytes;
+}
+
+}
 
 SalesOrderModel::SalesOrderModel(QObject* parent)
     : QAbstractTableModel(parent)
     , stateFilter(-1)
+    , serverSide(false)
+    , serverRowCount(0)
+    , unfilteredRowCount(0)
+    , sortColumn(IdColumn)
+    , sortOrder(Qt::AscendingOrder)
+    , productSearch(false)
+    , search(new SalesOrderSearch(QSqlDatabase::database().databaseName(), this))
+    , searchGeneration(0)
+    , invalidateTimer(new QTimer(this))
+    , itemsBytes(0)
+    , pagesBytes(0)
 {
+    invalidateTimer->setSingleShot(true);
+    invalidateTimer->setInterval(InvalidateWindow);
+    connect(invalidateTimer, SIGNAL(timeout()), SLOT(flushInvalidated()));
+    connect(search, SIGNAL(found(int,QList<qlonglong>,QList<int>)), SLOT(onSearchFound(int,QList<qlonglong>,QList<int>)));
+
+    MemoryAccounting::track(this, "SalesOrderModel.items", [this]() { return MemoryUsage::of(items) + itemsBytes; });
+    MemoryAccounting::track(this, "SalesOrderModel.rowById", [this]() { return MemoryUsage::of(rowById); });
+    MemoryAccounting::track(this, "SalesOrderModel.pages", [this]() -> qint64 {
+        qint64 bytes = MemoryUsage::of(pages) + MemoryUsage::of(recentPages) + MemoryUsage::of(pageBounds) + pagesBytes;
+        for (const QList<Row>& page: pages)
+            bytes += MemoryUsage::of(page);
+        return bytes;
+    });
+    MemoryAccounting::track(this, "SalesOrderModel.hitCounts", [this]() { return MemoryUsage::of(hitCounts); });
 }
 
 QVariant SalesOrderModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    if (orientation == Qt::Horizontal) {
-        if (role == Qt::DisplayRole) {
-            switch (section) {
-            case IdColumn: return "Nomor";
-            case StateColumn: return "Status";
-            case OpenDateTimeColumn: return "Tanggal";
-            case GrandTotalColumn: return "Grand Total";
-            case CustomerNameColumn: return "Atas Nama";
-            case CustomerContactColumn: return "Kontak";
-            case CustomerAddressColumn: return "Alamat";
-            }
-        }
-    }
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < ColumnCount)
+        return columns[section].label;
 
     return QVariant();
 }
 
 int SalesOrderModel::columnCount(const QModelIndex& parent) const
 {
-    return parent.isValid() ? 0 : 7;
+    return parent.isValid() ? 0 : ColumnCount;
 }
 
 int SalesOrderModel::rowCount(const QModelIndex& parent) const
 {
-    return parent.isValid() ? 0 : items.size();
+    if (parent.isValid())
+        return 0;
+
+    return serverSide ? serverRowCount : items.size();
+}
+
+const SalesOrderModel::Row& SalesOrderModel::itemAt(int row) const
+{
+    if (!serverSide)
+        return items.at(row);
+
+    const int page = row / PageSize;
+    QHash<int, QList<Row>>::const_iterator it = pages.constFind(page);
+    if (it == pages.constEnd()) {
+        const QList<Row> rows = loadPage(page);
+
+        if (recentPages.size() >= MaxCachedPages)
+            pagesBytes -= rowsBytes(pages.take(recentPages.takeFirst()));
+
+        it = pages.insert(page, rows);
+        pagesBytes += rowsBytes(rows);
+    }
+    else
+        recentPages.removeOne(page);
+
+    recentPages.append(page);
+    return it->at(row % PageSize);
 }
 
-QVariant SalesOrderModel::data(const QModelIndex& index, int role) const
+// Pages are read by keyset: the next page seeks past the last key of the one before it, and scrolling up seeks
+// before the first key of the one after it, so neighbouring pages stay on the sort column's index. A jump
+// starts from the nearest page whose bounds are known, or from either end of the list, and skips only the
+// keys in between.
+QList<SalesOrderModel::Row> SalesOrderModel::loadPage(int page) const
+{
+    const int first = page * PageSize;
+    const int size = qMin(PageSize, serverRowCount - first);
+
+    const SortKey* anchor = 0;
+    bool forward = true;
+    int skip = first;
+
+    if (serverRowCount - first - size < skip) {
+        forward = false;
+        skip = serverRowCount - first - size;
+    }
+
+    for (QHash<int, PageBounds>::const_iterator it = pageBounds.constBegin(); it != pageBounds.constEnd(); ++it) {
+        if (it.key() < page && (page - it.key() - 1) * PageSize < skip) {
+            anchor = &it->last;
+            forward = true;
+            skip = (page - it.key() - 1) * PageSize;
+        }
+        else if (it.key() > page && (it.key() - page - 1) * PageSize < skip) {
+            anchor = &it->first;
+            forward = false;
+            skip = (it.key() - page - 1) * PageSize;
+        }
+    }
+
+    PageBounds bounds;
+    QList<Row> rows = fetchRows(anchor, forward, skip, size, bounds);
+
+    // Bounds are only kept for complete pages; rows that vanished since the count would shift them.
+    if (rows.size() == size && size > 0)
+        pageBounds.insert(page, bounds);
+
+    // Keep the loaded window complete even if rows vanished since the count.
+    while (rows.size() < size)
+        rows.append(Row());
+
+    return rows;
+}
+
+QList<SalesOrderModel::Row> SalesOrderModel::fetchRows(const SortKey* anchor, bool forward, int skip, int limit,
+                                                       PageBounds& bounds) const
 {
-    QVector<QVariant> item = items.at(index.row());
+    const QString key = orderByColumns[sortColumn];
+    const bool ascending = (sortOrder == Qt::AscendingOrder) == forward;
+    const QString direction = ascending ? "asc" : "desc";
+    const QString comparison = ascending ? ">" : "<";
+    const QString orderBy = QString(" order by %1 %2, id %2").arg(key, direction);
+    const QStringList schemas = sources();
 
-    if (role == Qt::DisplayRole) {
-        if (index.column() == GrandTotalColumn)
-            return QLocale().toString(item.at(index.column()).toDouble(), 'f', 0);
-        else if (index.column() == OpenDateTimeColumn)
-            return item.at(index.column()).toDateTime().date().toString("dd/MM/yyyy");
-        else if (index.column() == StateColumn) {
-            int state = item.at(index.column()).toInt();
-            return state == 0 ? "Aktif" : (state == 1 ? "Selesai" : "Dibatalkan");
+    QVariantList values;
+    QStringList selects;
+    for (const QString& schema: schemas) {
+        // Spelled as a range on the sort column alone, which SQLite seeks on; a row value comparison is scanned.
+        QStringList conditions;
+        if (anchor) {
+            conditions.append(QString("%1 %2= ? and (%1 %2 ? or id %2 ?)").arg(key, comparison));
+            values << anchor->value << anchor->value << anchor->id;
         }
+
+        QString sql = SELECT_SALES_ORDER_COLUMNS ", " + key + " from " + schema + ".sales_orders"
+                + whereClause(schema, true, values, conditions) + orderBy;
+
+        // With the archive attached each table is sorted on its own index and only the heads are merged.
+        if (schemas.size() > 1) {
+            sql += " limit ?";
+            values << skip + limit;
+        }
+        selects.append(sql);
+    }
+
+    QString sql = selects.first();
+    if (selects.size() > 1) {
+        sql = "select * from (" + selects.join(") union all select * from (") + ")"
+                + QString(" order by %1 %2, 1 %2").arg(int(ColumnCount) + 1).arg(direction);
     }
+    sql += " limit ? offset ?";
+    values << limit << skip;
 
-    if (role == Qt::DisplayRole || role == Qt::EditRole)
-        return item.at(index.column());
-    else if (role == Qt::TextAlignmentRole) {
-        if (index.column() == IdColumn || index.column() == GrandTotalColumn)
-            return Qt::AlignRight ^ Qt::AlignVCenter;
-        else if (index.column() == StateColumn)
-            return Qt::AlignCenter;
-        return Qt::AlignLeft ^ Qt::AlignVCenter;
+    PreparedQuery q(sql);
+    bindValues(*q, values);
+    q->exec();
+
+    QList<Row> rows;
+    while (q->next()) {
+        rows.append(createItem(*q));
+
+        // Read in query order; the bounds are swapped back below when reading backwards.
+        SortKey& sortKey = rows.size() == 1 ? bounds.first : bounds.last;
+        sortKey.value = q->value(ColumnCount);
+        sortKey.id = rows.last().id;
     }
+
+    if (rows.size() == 1)
+        bounds.last = bounds.first;
+
+    if (!forward) {
+        std::reverse(rows.begin(), rows.end());
+        std::swap(bounds.first, bounds.last);
+    }
+
+    return rows;
+}
+
+QVariant SalesOrderModel::data(const QModelIndex& index, int role) const
+{
+    const Row& item = itemAt(index.row());
+    const ColumnDescriptor<Row>& column = columns[index.column()];
+
+    if (role == Qt::DisplayRole)
+        return column.display(item);
+    else if (role == Qt::EditRole)
+        return column.value(item);
+    else if (role == Qt::TextAlignmentRole)
+        return column.alignment | Qt::AlignVCenter;
     else if (role == Qt::BackgroundColorRole) {
-        int state = item.at(StateColumn).toInt();
-        return state == 1 ? QColor("#eeffee") : (state == 2 ? QColor("#ffeeee") : QVariant());
+        static const QVariant completedColor = QColor("#eeffee");
+        static const QVariant cancelledColor = QColor("#ffeeee");
+        return item.state == 1 ? completedColor : (item.state == 2 ? cancelledColor : QVariant());
     }
 
     return QVariant();
 }
 
+bool SalesOrderModel::hasIntegerSortKey(int column) const
+{
+    return columns[column].hasIntegerSortKey;
+}
+
+qint64 SalesOrderModel::integerSortKey(int row, int column) const
+{
+    return columns[column].integerSortKey(items.at(row));
+}
+
+QString SalesOrderModel::textSortKey(int row, int column) const
+{
+    return columns[column].value(items.at(row)).toString().toCaseFolded();
+}
+
+QStringList SalesOrderModel::sources() const
+{
+    // Only closed orders are ever archived, so the active list never needs the archive.
+    if (stateFilter != 0 && Archiver::attach())
+        return QStringList() << "main" << "archive";
+
+    return QStringList() << "main";
+}
+
+QString SalesOrderModel::whereClause(const QString& schema, bool search, QVariantList& values, QStringList conditions) const
+{
+    if (stateFilter >= 0) {
+        conditions.append("state=?");
+        values.append(stateFilter);
+    }
+
+    // Bound as plain dates so the range matches both "T" and space separated timestamps.
+    if (fromDate.isValid()) {
+        conditions.append("open_datetime>=?");
+        values.append(fromDate.toString(Qt::ISODate));
+    }
+
+    if (toDate.isValid()) {
+        conditions.append("open_datetime<?");
+        values.append(toDate.addDays(1).toString(Qt::ISODate));
+    }
+
+    // Customer words are matched by prefix through the full-text index; a number also matches the order id.
+    const QString expression = search ? SalesOrderSearch::matchExpression(searchText) : QString();
+    if (!expression.isEmpty()) {
+        conditions.append("(id in (select rowid from " + schema + ".sales_orders_fts where sales_orders_fts match ?) or id=?)");
+        values << expression << searchText.trimmed().toLongLong();
+    }
+
+    return conditions.isEmpty() ? QString() : " where " + conditions.join(" and ");
+}
+
+int SalesOrderModel::countRows(bool search) const
+{
+    QVariantList values;
+    QStringList counts;
+    for (const QString& schema: sources())
+        counts.append("(select count(*) from " + schema + ".sales_orders" + whereClause(schema, search, values) + ")");
+
+    PreparedQuery q("select " + counts.join(" + "));
+    bindValues(*q, values);
+    q->exec();
+
+    return q->next() ? q->value(0).toInt() : 0;
+}
+
+void SalesOrderModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= columnCount())
+        return;
+
+    if (column == sortColumn && order == sortOrder)
+        return;
+
+    sortColumn = column;
+    sortOrder = order;
+
+    if (serverSide)
+        reloadWindow();
+}
+
+void SalesOrderModel::setSearchText(const QString& text)
+{
+    if (text == searchText)
+        return;
+
+    searchText = text;
+
+    if (productSearch)
+        startProductSearch();
+    else if (serverSide)
+        reloadWindow();
+}
+
+void SalesOrderModel::setProductSearch(bool enabled)
+{
+    productSearch = enabled;
+}
+
+void SalesOrderModel::setDateRange(const QDate& from, const QDate& to)
+{
+    fromDate = from;
+    toDate = to;
+}
+
+void SalesOrderModel::reloadWindow()
+{
+    beginResetModel();
+    pages.clear();
+    pagesBytes = 0;
+    recentPages.clear();
+    pageBounds.clear();
+    serverRowCount = countRows(true);
+    endResetModel();
+}
+
 void SalesOrderModel::refreshAll(int pStateFilter)
 {
     stateFilter = pStateFilter;
-    QString sql = SELECT_COLUMNS_FROM_SALES_ORDERS;
 
-    if (stateFilter >= 0)
-        sql.append(" where state=" + QString::number(stateFilter));
+    // Line item matches come from the full-text index and are streamed in by the search thread.
+    if (productSearch) {
+        serverSide = false;
+        startProductSearch();
+        return;
+    }
+
+    unfilteredRowCount = countRows(false);
+    if (unfilteredRowCount > ServerSideThreshold) {
+        serverSide = true;
+        beginResetModel();
+        items.clear();
+        itemsBytes = 0;
+        rowById.clear();
+        pages.clear();
+        pagesBytes = 0;
+        recentPages.clear();
+        pageBounds.clear();
+        serverRowCount = searchText.isEmpty() ? unfilteredRowCount : countRows(true);
+        endResetModel();
+        return;
+    }
+
+    serverSide = false;
+
+    QVariantList values;
+    QStringList selects;
+    for (const QString& schema: sources())
+        selects.append(SELECT_SALES_ORDER_COLUMNS "from " + schema + ".sales_orders" + whereClause(schema, false, values));
 
-    QSqlQuery q;
-    q.prepare(sql);
-    q.exec();
+    PreparedQuery q(selects.join(" union all "));
+    bindValues(*q, values);
+    q->exec();
 
     beginResetModel();
     items.clear();
+    itemsBytes = 0;
     rowById.clear();
+    pages.clear();
+    pagesBytes = 0;
+    recentPages.clear();
+    pageBounds.clear();
 
     int row = 0;
-    while (q.next()) {
-        const QVector<QVariant> item = createItem(q);
+    while (q->next()) {
+        const Row item = createItem(*q);
         items.append(item);
-        rowById.insert(item.at(IdColumn).toLongLong(), row);
+        itemsBytes += rowBytes(item);
+        rowById.insert(item.id, row);
         row++;
     }
 
     endResetModel();
 }
 
-QVector<QVariant> SalesOrderModel::createItem(QSqlQuery &q)
+SalesOrderModel::Row SalesOrderModel::createItem(QSqlQuery &q) const
 {
-    QVector<QVariant> item(columnCount());
-    for (int col = 0; col < columnCount(); col++)
-        item[col] = q.value(col);
+    Row item;
+    SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_READ, SALES_ORDER_MODEL_COLUMN_READ)
+
+    if (productSearch)
+        item.hits = hitCounts.value(item.id);
     return item;
 }
 
-void SalesOrderModel::refresh(qlonglong id)
+void SalesOrderModel::startProductSearch()
 {
-    QString sql = SELECT_COLUMNS_FROM_SALES_ORDERS " where id=" + QString::number(id);
+    beginResetModel();
+    items.clear();
+    itemsBytes = 0;
+    rowById.clear();
+    pages.clear();
+    pagesBytes = 0;
+    recentPages.clear();
+    pageBounds.clear();
+    hitCounts.clear();
+    endResetModel();
 
-    if (stateFilter >= 0)
-        sql.append(" and state=" + QString::number(stateFilter));
+    searchGeneration++;
+    if (!searchText.isEmpty())
+        search->search(searchGeneration, searchText);
+}
 
-    QSqlQuery q;
-    q.prepare(sql);
-    q.exec();
-    int row = rowById.value(id, -1);
+void SalesOrderModel::onSearchFound(int generation, const QList<qlonglong>& ids, const QList<int>& hits)
+{
+    if (generation != searchGeneration || !productSearch)
+        return;
 
-    if (!q.next()) {
-        if (row >= 0) {
-            beginRemoveRows(QModelIndex(), row, row);
-            rowById.remove(id);
-            items.removeAt(row);
-            endRemoveRows();
+    for (int i = 0; i < ids.size(); i++)
+        hitCounts.insert(ids.at(i), hits.at(i));
+
+    refresh(ids);
+}
+
+void SalesOrderModel::invalidate(qlonglong id)
+{
+    invalidatedIds.insert(id);
+
+    if (!invalidateTimer->isActive())
+        invalidateTimer->start();
+}
+
+void SalesOrderModel::invalidate(const QList<qlonglong>& ids)
+{
+    if (ids.isEmpty())
+        return;
+
+    invalidatedIds.unite(ids.toSet());
+
+    if (!invalidateTimer->isActive())
+        invalidateTimer->start();
+}
+
+void SalesOrderModel::flushInvalidated()
+{
+    const QList<qlonglong> ids = invalidatedIds.toList();
+    invalidatedIds.clear();
+
+    // Edited orders may have gained or lost matching lines.
+    if (productSearch) {
+        for (int offset = 0; offset < ids.size(); offset += RefreshChunkSize) {
+            const QList<qlonglong> chunk = ids.mid(offset, RefreshChunkSize);
+            const QHash<qlonglong, int> hits = SalesOrderSearch::countHits(searchText, chunk);
+            for (qlonglong id: chunk) {
+                if (hits.contains(id))
+                    hitCounts.insert(id, hits.value(id));
+                else
+                    hitCounts.remove(id);
+            }
+        }
+    }
+
+    refresh(ids);
+}
+
+// Only the cached pages are on screen. A changed row that is cached and keeps its sort value is patched where
+// it is; anything that may have moved rows between positions drops the pages, and only a changed count resets.
+void SalesOrderModel::refreshServerSide(const QList<qlonglong>& ids)
+{
+    QHash<qlonglong, Row> fetched;
+
+    for (int offset = 0; offset < ids.size(); offset += RefreshChunkSize) {
+        const QList<qlonglong> chunk = ids.mid(offset, RefreshChunkSize);
+        QStringList placeholders;
+        for (int i = 0; i < chunk.size(); i++)
+            placeholders.append("?");
+
+        QVariantList values;
+        QStringList selects;
+        for (const QString& schema: sources()) {
+            for (qlonglong id: chunk)
+                values.append(id);
+            selects.append(SELECT_SALES_ORDER_COLUMNS "from " + schema + ".sales_orders"
+                           + whereClause(schema, true, values, QStringList("id in (" + placeholders.join(",") + ")")));
         }
+
+        PreparedQuery q(selects.join(" union all "));
+        bindValues(*q, values);
+        q->exec();
+
+        while (q->next()) {
+            const Row item = createItem(*q);
+            fetched.insert(item.id, item);
+        }
+    }
+
+    const ColumnDescriptor<Row>& sortBy = columns[sortColumn];
+    QSet<qlonglong> uncached = ids.toSet();
+    QList<int> patchedRows;
+    bool moved = false;
+
+    for (QHash<int, QList<Row>>::iterator page = pages.begin(); page != pages.end(); ++page) {
+        for (int i = 0; i < page->size(); i++) {
+            const qlonglong id = page->at(i).id;
+            if (!uncached.remove(id))
+                continue;
+
+            QHash<qlonglong, Row>::const_iterator it = fetched.constFind(id);
+            if (it == fetched.constEnd() || sortBy.value(*it) != sortBy.value(page->at(i)))
+                moved = true;
+            else {
+                pagesBytes += rowBytes(it.value()) - rowBytes(page->at(i));
+                (*page)[i] = it.value();
+                patchedRows.append(page.key() * PageSize + i);
+            }
+        }
+    }
+
+    // Rows off screen that match now may have moved in, and rows that no longer match leave a gap.
+    for (qlonglong id: uncached) {
+        if (fetched.contains(id))
+            moved = true;
+    }
+
+    if (!uncached.isEmpty() || moved) {
+        const int count = countRows(true);
+        unfilteredRowCount = searchText.isEmpty() ? count : countRows(false);
+        if (count != serverRowCount) {
+            beginResetModel();
+            pages.clear();
+            pagesBytes = 0;
+            recentPages.clear();
+            pageBounds.clear();
+            serverRowCount = count;
+            endResetModel();
+            return;
+        }
+    }
+
+    if (moved) {
+        int first = serverRowCount;
+        int last = -1;
+        for (int page: recentPages) {
+            first = qMin(first, page * PageSize);
+            last = qMax(last, qMin(serverRowCount, (page + 1) * PageSize) - 1);
+        }
+
+        pages.clear();
+        pagesBytes = 0;
+        recentPages.clear();
+        pageBounds.clear();
+
+        if (last >= first)
+            emit dataChanged(index(first, 0), index(last, columnCount() - 1));
         return;
     }
 
-    if (row == -1) {
-        row = rowCount();
-        beginInsertRows(QModelIndex(), row, row);
-        rowById.insert(id, row);
-        items.append(createItem(q));
-        endInsertRows();
+    for (int row: patchedRows)
+        emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+void SalesOrderModel::refresh(qlonglong id)
+{
+    refresh(QList<qlonglong>() << id);
+}
+
+void SalesOrderModel::refresh(const QList<qlonglong>& ids)
+{
+    if (ids.isEmpty())
+        return;
+
+    if (serverSide) {
+        refreshServerSide(ids);
         return;
     }
 
-    items[row] = createItem(q);
-    const QModelIndex idx = index(row, 0);
-    emit dataChanged(idx, idx.sibling(row, columnCount() - 1));
-    return;
+    QHash<qlonglong, Row> fetched;
+
+    for (int offset = 0; offset < ids.size(); offset += RefreshChunkSize) {
+        QVariantList values;
+        QStringList placeholders;
+        for (qlonglong id: ids.mid(offset, RefreshChunkSize)) {
+            placeholders.append("?");
+            values.append(id);
+        }
+
+        const QString sql = SELECT_SALES_ORDER_COLUMNS "from main.sales_orders"
+                + whereClause("main", false, values, QStringList("id in (" + placeholders.join(",") + ")"));
+
+        // Full chunks share one cached statement; only the last chunk varies in size.
+        PreparedQuery q(sql);
+        bindValues(*q, values);
+        q->exec();
+
+        while (q->next()) {
+            const Row item = createItem(*q);
+            if (!productSearch || hitCounts.contains(item.id))
+                fetched.insert(item.id, item);
+        }
+    }
+
+    QList<int> removedRows;
+    QList<qlonglong> insertedIds;
+
+    for (qlonglong id: ids) {
+        const int row = rowById.value(id, -1);
+        QHash<qlonglong, Row>::const_iterator it = fetched.constFind(id);
+
+        if (it == fetched.constEnd()) {
+            if (row >= 0)
+                removedRows.append(row);
+        }
+        else if (row == -1)
+            insertedIds.append(id);
+        else {
+            itemsBytes += rowBytes(it.value()) - rowBytes(items.at(row));
+            items[row] = it.value();
+        }
+    }
+
+    if (!removedRows.isEmpty()) {
+        // Remove from the bottom up in contiguous runs so earlier rows keep their positions.
+        std::sort(removedRows.begin(), removedRows.end());
+
+        int last = removedRows.size() - 1;
+        while (last >= 0) {
+            int first = last;
+            while (first > 0 && removedRows.at(first - 1) == removedRows.at(first) - 1)
+                first--;
+
+            beginRemoveRows(QModelIndex(), removedRows.at(first), removedRows.at(last));
+            for (int i = last; i >= first; i--) {
+                itemsBytes -= rowBytes(items.at(removedRows.at(i)));
+                items.removeAt(removedRows.at(i));
+            }
+            endRemoveRows();
+
+            last = first - 1;
+        }
+
+        rowById.clear();
+        for (int row = 0; row < items.size(); row++)
+            rowById.insert(items.at(row).id, row);
+    }
+
+    int firstChanged = items.size();
+    int lastChanged = -1;
+    for (QHash<qlonglong, Row>::const_iterator it = fetched.constBegin(); it != fetched.constEnd(); ++it) {
+        const int row = rowById.value(it.key(), -1);
+        if (row >= 0) {
+            firstChanged = qMin(firstChanged, row);
+            lastChanged = qMax(lastChanged, row);
+        }
+    }
+
+    // One range for all updated rows, so the proxy re-sorts and re-filters once.
+    if (lastChanged >= 0)
+        emit dataChanged(index(firstChanged, 0), index(lastChanged, columnCount() - 1));
+
+    if (!insertedIds.isEmpty()) {
+        const int first = items.size();
+        beginInsertRows(QModelIndex(), first, first + insertedIds.size() - 1);
+        for (qlonglong id: insertedIds) {
+            rowById.insert(id, items.size());
+            items.append(fetched.value(id));
+            itemsBytes += rowBytes(items.last());
+        }
+        endInsertRows();
+    }
 }
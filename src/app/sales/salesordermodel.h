@@ -2,21 +2,43 @@
 #define SALESORDERMODEL_H
 
 #include <QAbstractTableModel>
+#include <QSet>
+#include <QStringList>
+#include <QDateTime>
+
+#include "columnschema.h"
 
 class QSqlQuery;
+class QTimer;
+class SalesOrderSearch;
+
+// The order list's columns, in display order: enum name, row member, type, SQL expression, sort expression,
+// header, alignment and display format. Everything column-specific in the model is expanded from this list.
+#define SALES_ORDER_MODEL_COLUMNS(FIRST, NEXT) \
+    FIRST(IdColumn, id, qlonglong, "id", "id", "Nomor", Qt::AlignRight, ColumnSchema::plain<qlonglong>) \
+    NEXT(StateColumn, state, int, "state", "state", "Status", Qt::AlignHCenter, stateText) \
+    NEXT(OpenDateTimeColumn, openDateTime, QDateTime, "open_datetime", "open_datetime", "Tanggal", Qt::AlignLeft, ColumnSchema::date) \
+    NEXT(GrandTotalColumn, grandTotal, double, "grand_total", "grand_total", "Grand Total", Qt::AlignRight, ColumnSchema::money) \
+    NEXT(CustomerNameColumn, customerName, QString, "customer_name", "customer_name collate nocase", "Atas Nama", Qt::AlignLeft, ColumnSchema::plain<QString>) \
+    NEXT(CustomerContactColumn, customerContact, QString, "customer_contact", "customer_contact collate nocase", "Kontak", Qt::AlignLeft, ColumnSchema::plain<QString>) \
+    NEXT(CustomerAddressColumn, customerAddress, QString, "customer_address", "customer_address collate nocase", "Alamat", Qt::AlignLeft, ColumnSchema::plain<QString>) \
+    NEXT(HitsColumn, hits, int, "0", "id", "Item Cocok", Qt::AlignRight, ColumnSchema::plain<int>)
+
+#define SALES_ORDER_MODEL_COLUMN_ENUM(column, ...) column,
+#define SALES_ORDER_MODEL_COLUMN_MEMBER(column, member, type, ...) type member = type();
 
 class SalesOrderModel : public QAbstractTableModel
 {
     Q_OBJECT
 public:
     enum Columns {
-        IdColumn,
-        StateColumn,
-        OpenDateTimeColumn,
-        GrandTotalColumn,
-        CustomerNameColumn,
-        CustomerContactColumn,
-        CustomerAddressColumn
+        SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_ENUM, SALES_ORDER_MODEL_COLUMN_ENUM)
+        ColumnCount
+    };
+
+    struct Row
+    {
+        SALES_ORDER_MODEL_COLUMNS(SALES_ORDER_MODEL_COLUMN_MEMBER, SALES_ORDER_MODEL_COLUMN_MEMBER)
     };
 
     SalesOrderModel(QObject* parent);
@@ -25,16 +47,84 @@ public:
     int columnCount(const QModelIndex& parent = QModelIndex()) const;
     int rowCount(const QModelIndex& parent = QModelIndex()) const;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+    bool hasIntegerSortKey(int column) const;
+    qint64 integerSortKey(int row, int column) const;
+    QString textSortKey(int row, int column) const;
+
+    bool isServerSide() const { return serverSide; }
+    int totalCount() const { return serverSide ? unfilteredRowCount : items.size(); }
+    void setSearchText(const QString& text);
+    bool isProductSearch() const { return productSearch; }
+    void setProductSearch(bool enabled);
+    void setDateRange(const QDate& from, const QDate& to);
 
     void refreshAll(int stateFilter);
     void refresh(qlonglong id);
+    void refresh(const QList<qlonglong>& ids);
+
+public slots:
+    void invalidate(qlonglong id);
+    void invalidate(const QList<qlonglong>& ids);
+
+private slots:
+    void flushInvalidated();
+    void onSearchFound(int generation, const QList<qlonglong>& ids, const QList<int>& hits);
 
 private:
-    QVector<QVariant> createItem(QSqlQuery &q);
+    // A row's position in the server-side order: its sort column value, then its id.
+    struct SortKey
+    {
+        QVariant value;
+        qlonglong id = 0;
+    };
+
+    struct PageBounds
+    {
+        SortKey first;
+        SortKey last;
+    };
+
+    Row createItem(QSqlQuery &q) const;
+    const Row& itemAt(int row) const;
+    QList<Row> loadPage(int page) const;
+    QList<Row> fetchRows(const SortKey* anchor, bool forward, int skip, int limit, PageBounds& bounds) const;
+    QStringList sources() const;
+    QString whereClause(const QString& schema, bool search, QVariantList& values,
+                        QStringList conditions = QStringList()) const;
+    int countRows(bool search) const;
+    void reloadWindow();
+    void refreshServerSide(const QList<qlonglong>& ids);
+    void startProductSearch();
 
-    QList<QVector<QVariant>> items;
+    QList<Row> items;
     QHash<qlonglong, int> rowById;
     int stateFilter;
+    QDate fromDate;
+    QDate toDate;
+
+    bool serverSide;
+    int serverRowCount;
+    int unfilteredRowCount;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+    QString searchText;
+    mutable QHash<int, QList<Row>> pages;
+    mutable QList<int> recentPages;
+    mutable QHash<int, PageBounds> pageBounds;
+
+    bool productSearch;
+    QHash<qlonglong, int> hitCounts;
+    SalesOrderSearch* search;
+    int searchGeneration;
+
+    QSet<qlonglong> invalidatedIds;
+    QTimer* invalidateTimer;
+
+    // String bytes of the held rows, kept as rows change so that accounting never walks them.
+    qint64 itemsBytes;
+    mutable qint64 pagesBytes;
 };
 
 #endif // SALESORDERMODEL_H
@@ -1,7 +1,55 @@
 #include "salesorderproxymodel.h"
+#include "salesordermodel.h"
+
+#include <algorithm>
+
+namespace {
+
+// Patching a cached column costs a binary search per changed row plus a pass over all ranks; past this share
+// of the rows, sorting from scratch is cheaper.
+const int PatchLimit = 8;
+
+// LSD radix sort of (key, row) pairs, skipping byte positions every key shares.
+void radixSort(QVector<quint64>& keys, QVector<int>& rows)
+{
+    const int n = keys.size();
+    QVector<quint64> keyBuffer(n);
+    QVector<int> rowBuffer(n);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[257] = {0};
+        for (int i = 0; i < n; i++)
+            counts[((keys.at(i) >> shift) & 0xff) + 1]++;
+
+        bool trivial = false;
+        for (int b = 1; b <= 256; b++) {
+            if (counts[b] == n) {
+                trivial = true;
+                break;
+            }
+        }
+        if (trivial)
+            continue;
+
+        for (int b = 0; b < 256; b++)
+            counts[b + 1] += counts[b];
+
+        for (int i = 0; i < n; i++) {
+            const int pos = counts[(keys.at(i) >> shift) & 0xff]++;
+            keyBuffer[pos] = keys.at(i);
+            rowBuffer[pos] = rows.at(i);
+        }
+
+        keys.swap(keyBuffer);
+        rows.swap(rowBuffer);
+    }
+}
+
+}
 
 SalesOrderProxyModel::SalesOrderProxyModel(QObject* parent)
     : QSortFilterProxyModel(parent)
+    , salesOrderModel(0)
 {
     setFilterCaseSensitivity(Qt::CaseInsensitive);
     setFilterKeyColumn(-1);
@@ -9,3 +57,261 @@ SalesOrderProxyModel::SalesOrderProxyModel(QObject* parent)
     setSortCaseSensitivity(Qt::CaseInsensitive);
     setSortRole(Qt::DisplayRole);
 }
+
+void SalesOrderProxyModel::setSourceModel(QAbstractItemModel* sourceModel)
+{
+    if (QSortFilterProxyModel::sourceModel())
+        QSortFilterProxyModel::sourceModel()->disconnect(this);
+
+    clearSortKeys();
+    salesOrderModel = qobject_cast<SalesOrderModel*>(sourceModel);
+
+    // Connected before the base class so stale keys are gone by the time it re-sorts.
+    if (sourceModel) {
+        connect(sourceModel, SIGNAL(modelReset()), SLOT(clearSortKeys()));
+        connect(sourceModel, SIGNAL(layoutChanged()), SLOT(clearSortKeys()));
+        connect(sourceModel, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(patchInsertedRows(QModelIndex,int,int)));
+        connect(sourceModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), SLOT(patchRemovedRows(QModelIndex,int,int)));
+        connect(sourceModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(patchChangedRows(QModelIndex,QModelIndex)));
+    }
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+void SalesOrderProxyModel::clearSortKeys()
+{
+    sortKeys.clear();
+}
+
+void SalesOrderProxyModel::patchInsertedRows(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid() || !salesOrderModel)
+        return;
+
+    const int count = last - first + 1;
+    QHash<int, SortKeys>::iterator it = sortKeys.begin();
+    while (it != sortKeys.end()) {
+        SortKeys& keys = *it;
+        const int n = keys.ranks.size();
+        if (n + count != salesOrderModel->rowCount() || count * PatchLimit > n) {
+            it = sortKeys.erase(it);
+            continue;
+        }
+
+        for (int& row: keys.order) {
+            if (row >= first)
+                row += count;
+        }
+
+        if (keys.integer)
+            keys.integerKeys.insert(first, count, 0);
+        else
+            keys.textKeys.insert(first, count, QString());
+
+        for (int row = first; row <= last; row++) {
+            readKey(keys, row, it.key());
+            insertIntoOrder(keys, row);
+        }
+
+        assignRanks(keys);
+        ++it;
+    }
+}
+
+void SalesOrderProxyModel::patchRemovedRows(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid() || !salesOrderModel)
+        return;
+
+    const int count = last - first + 1;
+    QHash<int, SortKeys>::iterator it = sortKeys.begin();
+    while (it != sortKeys.end()) {
+        SortKeys& keys = *it;
+        const int n = keys.ranks.size();
+        if (n - count != salesOrderModel->rowCount() || count * PatchLimit > n) {
+            it = sortKeys.erase(it);
+            continue;
+        }
+
+        // The keys still hold the removed rows, which is how they are found in the order.
+        for (int row = first; row <= last; row++)
+            removeFromOrder(keys, row);
+
+        if (keys.integer)
+            keys.integerKeys.remove(first, count);
+        else
+            keys.textKeys.remove(first, count);
+
+        for (int& row: keys.order) {
+            if (row > last)
+                row -= count;
+        }
+
+        assignRanks(keys);
+        ++it;
+    }
+}
+
+void SalesOrderProxyModel::patchChangedRows(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (topLeft.parent().isValid() || !salesOrderModel)
+        return;
+
+    QHash<int, SortKeys>::iterator it = sortKeys.begin();
+    while (it != sortKeys.end()) {
+        const int column = it.key();
+        if (column < topLeft.column() || column > bottomRight.column()) {
+            ++it;
+            continue;
+        }
+
+        SortKeys& keys = *it;
+        const int n = keys.ranks.size();
+        if (n != salesOrderModel->rowCount()) {
+            it = sortKeys.erase(it);
+            continue;
+        }
+
+        // Rows whose key did not change keep their place; only the others move.
+        int moved = 0;
+        for (int row = topLeft.row(); row <= bottomRight.row() && moved * PatchLimit <= n; row++) {
+            if (updateKey(keys, row, column))
+                moved++;
+        }
+
+        if (moved * PatchLimit > n) {
+            it = sortKeys.erase(it);
+            continue;
+        }
+
+        if (moved > 0)
+            assignRanks(keys);
+        ++it;
+    }
+}
+
+bool SalesOrderProxyModel::lessThan(const QModelIndex& left, const QModelIndex& right) const
+{
+    if (!salesOrderModel)
+        return QSortFilterProxyModel::lessThan(left, right);
+
+    if (salesOrderModel->isServerSide())
+        return left.row() < right.row();
+
+    const QVector<int>& r = ranks(left.column());
+    return r.at(left.row()) < r.at(right.row());
+}
+
+const QVector<int>& SalesOrderProxyModel::ranks(int column) const
+{
+    const int n = salesOrderModel->rowCount();
+    QHash<int, SortKeys>::iterator it = sortKeys.find(column);
+    if (it != sortKeys.end() && it->ranks.size() == n)
+        return it->ranks;
+
+    SortKeys keys;
+    keys.integer = salesOrderModel->hasIntegerSortKey(column);
+    keys.order.resize(n);
+    for (int i = 0; i < n; i++)
+        keys.order[i] = i;
+
+    if (keys.integer) {
+        keys.integerKeys.resize(n);
+        for (int i = 0; i < n; i++)
+            keys.integerKeys[i] = integerKey(i, column);
+
+        QVector<quint64> sorted = keys.integerKeys;
+        radixSort(sorted, keys.order);
+    }
+    else {
+        keys.textKeys.resize(n);
+        for (int i = 0; i < n; i++)
+            keys.textKeys[i] = salesOrderModel->textSortKey(i, column);
+
+        const QVector<QString>& textKeys = keys.textKeys;
+        std::stable_sort(keys.order.begin(), keys.order.end(), [&textKeys](int a, int b) {
+            return textKeys.at(a) < textKeys.at(b);
+        });
+    }
+
+    assignRanks(keys);
+    return sortKeys.insert(column, keys)->ranks;
+}
+
+quint64 SalesOrderProxyModel::integerKey(int row, int column) const
+{
+    // Flipping the sign bit makes signed keys sort correctly as unsigned ones.
+    return quint64(salesOrderModel->integerSortKey(row, column)) ^ (Q_UINT64_C(1) << 63);
+}
+
+void SalesOrderProxyModel::readKey(SortKeys& keys, int row, int column) const
+{
+    if (keys.integer)
+        keys.integerKeys[row] = integerKey(row, column);
+    else
+        keys.textKeys[row] = salesOrderModel->textSortKey(row, column);
+}
+
+bool SalesOrderProxyModel::updateKey(SortKeys& keys, int row, int column) const
+{
+    if (keys.integer) {
+        const quint64 key = integerKey(row, column);
+        if (key == keys.integerKeys.at(row))
+            return false;
+
+        removeFromOrder(keys, row);
+        keys.integerKeys[row] = key;
+    }
+    else {
+        const QString key = salesOrderModel->textSortKey(row, column);
+        if (key == keys.textKeys.at(row))
+            return false;
+
+        removeFromOrder(keys, row);
+        keys.textKeys[row] = key;
+    }
+
+    insertIntoOrder(keys, row);
+    return true;
+}
+
+bool SalesOrderProxyModel::keyLess(const SortKeys& keys, int a, int b)
+{
+    if (keys.integer)
+        return keys.integerKeys.at(a) < keys.integerKeys.at(b);
+
+    return keys.textKeys.at(a) < keys.textKeys.at(b);
+}
+
+void SalesOrderProxyModel::insertIntoOrder(SortKeys& keys, int row)
+{
+    // Anywhere among rows with an equal key will do, since they share a rank.
+    QVector<int>::iterator position = std::upper_bound(keys.order.begin(), keys.order.end(), row,
+                                                       [&keys](int a, int b) { return keyLess(keys, a, b); });
+    keys.order.insert(position, row);
+}
+
+void SalesOrderProxyModel::removeFromOrder(SortKeys& keys, int row)
+{
+    QVector<int>::iterator position = std::lower_bound(keys.order.begin(), keys.order.end(), row,
+                                                       [&keys](int a, int b) { return keyLess(keys, a, b); });
+    while (position != keys.order.end() && *position != row)
+        ++position;
+
+    if (position != keys.order.end())
+        keys.order.erase(position);
+}
+
+// Rows with equal keys share a rank, so that the proxy's own stable sort keeps them in source order.
+void SalesOrderProxyModel::assignRanks(SortKeys& keys)
+{
+    const int n = keys.order.size();
+    keys.ranks.resize(n);
+
+    int rank = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && keyLess(keys, keys.order.at(i - 1), keys.order.at(i)))
+            rank++;
+        keys.ranks[keys.order.at(i)] = rank;
+    }
+}
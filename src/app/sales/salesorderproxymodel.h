@@ -2,12 +2,50 @@
 #define SALESORDERPROXYMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <QVector>
+#include <QHash>
+
+class SalesOrderModel;
 
 class SalesOrderProxyModel : public QSortFilterProxyModel
 {
     Q_OBJECT
 public:
     SalesOrderProxyModel(QObject* parent);
+
+    void setSourceModel(QAbstractItemModel* sourceModel);
+
+protected:
+    bool lessThan(const QModelIndex& left, const QModelIndex& right) const;
+
+private slots:
+    void clearSortKeys();
+    void patchInsertedRows(const QModelIndex& parent, int first, int last);
+    void patchRemovedRows(const QModelIndex& parent, int first, int last);
+    void patchChangedRows(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+private:
+    // One sorted column: every row's key, the rows in key order, and each row's rank in that order.
+    struct SortKeys
+    {
+        bool integer;
+        QVector<quint64> integerKeys;
+        QVector<QString> textKeys;
+        QVector<int> order;
+        QVector<int> ranks;
+    };
+
+    const QVector<int>& ranks(int column) const;
+    quint64 integerKey(int row, int column) const;
+    void readKey(SortKeys& keys, int row, int column) const;
+    bool updateKey(SortKeys& keys, int row, int column) const;
+    static bool keyLess(const SortKeys& keys, int a, int b);
+    static void insertIntoOrder(SortKeys& keys, int row);
+    static void removeFromOrder(SortKeys& keys, int row);
+    static void assignRanks(SortKeys& keys);
+
+    SalesOrderModel* salesOrderModel;
+    mutable QHash<int, SortKeys> sortKeys;
 };
 
 #endif // SALESORDERPROXYMODEL_H
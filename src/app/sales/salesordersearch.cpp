@@ -0,0 +1,191 @@
+#include "salesordersearch.h"
+#include "db/preparedquery.h"
+
+#include <QSqlQuery>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+
+namespace {
+
+const char* const ConnectionName = "search";
+
+// Matching orders are handed to the list once this many have been touched, or after this many milliseconds,
+// whichever comes first.
+const int BatchSize = 500;
+const int BatchInterval = 200;
+
+const char* const SelectHits =
+        "select d.parent_id, count(*) from sales_order_details_fts"
+        " join sales_order_details d on d.id=sales_order_details_fts.rowid"
+        " where sales_order_details_fts match ?";
+
+// Matching lines straight from the index, newest first, so the first rows arrive without reading the rest.
+const char* const SelectMatches =
+        "select d.parent_id from sales_order_details_fts"
+        " join sales_order_details d on d.id=sales_order_details_fts.rowid"
+        " where sales_order_details_fts match ? order by sales_order_details_fts.rowid desc";
+
+}
+
+SalesOrderSearch::SalesOrderSearch(const QString& databaseName, QObject* parent)
+    : QThread(parent)
+    , databaseName(databaseName)
+    , pendingGeneration(0)
+    , hasPending(false)
+    , stopping(false)
+{
+    qRegisterMetaType<QList<qlonglong>>("QList<qlonglong>");
+    qRegisterMetaType<QList<int>>("QList<int>");
+}
+
+SalesOrderSearch::~SalesOrderSearch()
+{
+    stop();
+}
+
+void SalesOrderSearch::search(int generation, const QString& text)
+{
+    QMutexLocker locker(&mutex);
+    pendingGeneration = generation;
+    pendingText = text;
+    hasPending = true;
+    condition.wakeOne();
+
+    if (!isRunning())
+        start(LowPriority);
+}
+
+void SalesOrderSearch::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        condition.wakeOne();
+    }
+
+    wait();
+}
+
+QString SalesOrderSearch::matchExpression(const QString& text)
+{
+    // Every word is quoted so user input never reaches the FTS5 query syntax, and matched as a prefix.
+    QStringList terms;
+    for (QString word: text.split(' ', QString::SkipEmptyParts))
+        terms.append("\"" + word.replace('"', "\"\"") + "\"*");
+
+    return terms.join(' ');
+}
+
+QHash<qlonglong, int> SalesOrderSearch::countHits(const QString& text, const QList<qlonglong>& ids, QSqlDatabase db)
+{
+    QHash<qlonglong, int> hits;
+    const QString expression = matchExpression(text);
+    if (expression.isEmpty() || ids.isEmpty())
+        return hits;
+
+    QStringList placeholders;
+    for (int i = 0; i < ids.size(); i++)
+        placeholders.append("?");
+
+    PreparedQuery q(QString(SelectHits) + " and d.parent_id in (" + placeholders.join(",") + ") group by d.parent_id", db);
+    q->bindValue(0, expression);
+    for (int i = 0; i < ids.size(); i++)
+        q->bindValue(i + 1, ids.at(i));
+    q->exec();
+
+    while (q->next())
+        hits.insert(q->value(0).toLongLong(), q->value(1).toInt());
+
+    return hits;
+}
+
+bool SalesOrderSearch::isSuperseded(int generation)
+{
+    QMutexLocker locker(&mutex);
+    return stopping || (hasPending && pendingGeneration != generation);
+}
+
+void SalesOrderSearch::emitFound(int generation, const QList<qlonglong>& ids, const QHash<qlonglong, int>& totals)
+{
+    QList<int> hits;
+    hits.reserve(ids.size());
+    for (qlonglong id: ids)
+        hits.append(totals.value(id));
+
+    emit found(generation, ids, hits);
+}
+
+void SalesOrderSearch::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ConnectionName);
+        db.setDatabaseName(databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000;QSQLITE_OPEN_READONLY");
+        db.open();
+
+        forever {
+            int generation;
+            QString text;
+            {
+                QMutexLocker locker(&mutex);
+                while (!hasPending && !stopping)
+                    condition.wait(&mutex);
+
+                if (stopping)
+                    break;
+
+                generation = pendingGeneration;
+                text = pendingText;
+                hasPending = false;
+            }
+
+            PreparedQuery q(SelectMatches, db);
+            q->bindValue(0, matchExpression(text));
+            q->exec();
+
+            // Hits are counted here as lines come in. Every batch carries the running totals of the orders
+            // touched since the last one, and a newer search abandons this one between batches.
+            QHash<qlonglong, int> totals;
+            QList<qlonglong> touched;
+            QSet<qlonglong> inBatch;
+            QElapsedTimer sinceBatch;
+            sinceBatch.start();
+            bool superseded = false;
+            while (q->next()) {
+                const qlonglong id = q->value(0).toLongLong();
+                totals[id]++;
+                if (!inBatch.contains(id)) {
+                    inBatch.insert(id);
+                    touched.append(id);
+                }
+
+                if (touched.size() >= BatchSize || sinceBatch.elapsed() >= BatchInterval) {
+                    superseded = isSuperseded(generation);
+                    if (superseded)
+                        break;
+
+                    emitFound(generation, touched, totals);
+                    touched.clear();
+                    inBatch.clear();
+                    sinceBatch.restart();
+                }
+            }
+            q->finish();
+
+            if (superseded)
+                continue;
+
+            if (!touched.isEmpty())
+                emitFound(generation, touched, totals);
+
+            emit searchFinished(generation, totals.size());
+        }
+
+        PreparedQuery::clearCache(ConnectionName);
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(ConnectionName);
+}
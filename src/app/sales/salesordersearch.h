@@ -0,0 +1,44 @@
+#ifndef SALESORDERSEARCH_H
+#define SALESORDERSEARCH_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSqlDatabase>
+#include <QHash>
+
+class SalesOrderSearch : public QThread
+{
+    Q_OBJECT
+public:
+    SalesOrderSearch(const QString& databaseName, QObject* parent = 0);
+    ~SalesOrderSearch();
+
+    void search(int generation, const QString& text);
+    void stop();
+
+    static QString matchExpression(const QString& text);
+    static QHash<qlonglong, int> countHits(const QString& text, const QList<qlonglong>& ids,
+                                           QSqlDatabase db = QSqlDatabase::database());
+
+signals:
+    void found(int generation, const QList<qlonglong>& ids, const QList<int>& hits);
+    void searchFinished(int generation, int count);
+
+protected:
+    void run();
+
+private:
+    bool isSuperseded(int generation);
+    void emitFound(int generation, const QList<qlonglong>& ids, const QHash<qlonglong, int>& totals);
+
+    QString databaseName;
+    QMutex mutex;
+    QWaitCondition condition;
+    int pendingGeneration;
+    QString pendingText;
+    bool hasPending;
+    bool stopping;
+};
+
+#endif // SALESORDERSEARCH_H
@@ -0,0 +1,65 @@
+#include "stockledger.h"
+#include "db/preparedquery.h"
+
+#include <QSqlDatabase>
+#include <QVariantMap>
+
+bool StockLedger::postOrder(QSqlDatabase& db, qlonglong orderId, QVariantList& balances)
+{
+    return postOrders(db, "select ?", QVariantList() << orderId, balances);
+}
+
+bool StockLedger::postOrders(QSqlDatabase& db, const QString& orderIds, const QVariantList& values, QVariantList& balances)
+{
+    // Posts the difference between what each order should have taken from stock and what its movements
+    // already took, per product. This covers new lines, quantity edits, deleted lines, cancelled
+    // (state 2) and deleted orders alike, and posting twice is a no-op.
+    PreparedQuery post("insert into stock_movements (product_id, quantity, order_id)"
+                       " select product_id, sum(quantity), order_id from ("
+                       "  select d.product_id, -d.quantity as quantity, d.parent_id as order_id"
+                       "   from sales_order_details d"
+                       "   join sales_orders o on o.id=d.parent_id and o.state<>2"
+                       "   where d.parent_id in (" + orderIds + ") and d.product_id is not null"
+                       "  union all"
+                       "  select product_id, -quantity, order_id from stock_movements where order_id in (" + orderIds + ")"
+                       " ) group by order_id, product_id having sum(quantity)<>0", db);
+    for (int i = 0; i < values.size(); i++) {
+        post->bindValue(i, values.at(i));
+        post->bindValue(values.size() + i, values.at(i));
+    }
+    if (!post->exec())
+        return false;
+
+    return readBalances(db, "select distinct product_id from stock_movements where order_id in (" + orderIds + ")",
+                        values, balances);
+}
+
+bool StockLedger::adjust(QSqlDatabase& db, qlonglong productId, int quantity, QVariantList& balances)
+{
+    PreparedQuery post("insert into stock_movements (product_id, quantity) values (?, ?)", db);
+    post->bindValue(0, productId);
+    post->bindValue(1, quantity);
+    if (!post->exec())
+        return false;
+
+    return readBalances(db, "select ?", QVariantList() << productId, balances);
+}
+
+bool StockLedger::readBalances(QSqlDatabase& db, const QString& productIds, const QVariantList& values, QVariantList& balances)
+{
+    PreparedQuery q("select product_id, quantity, tracked from stock_balances where product_id in (" + productIds + ")", db);
+    for (int i = 0; i < values.size(); i++)
+        q->bindValue(i, values.at(i));
+    if (!q->exec())
+        return false;
+
+    while (q->next()) {
+        QVariantMap balance;
+        balance.insert("productId", q->value(0));
+        balance.insert("quantity", q->value(1));
+        balance.insert("tracked", q->value(2));
+        balances.append(balance);
+    }
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef STOCKLEDGER_H
+#define STOCKLEDGER_H
+
+#include <QVariantList>
+
+class QSqlDatabase;
+
+// Append-only stock movements; stock_balances is kept current by a trigger on every movement. Lines are
+// matched to products by the product_id recorded when they were written, never by their name.
+class StockLedger
+{
+public:
+    static bool postOrder(QSqlDatabase& db, qlonglong orderId, QVariantList& balances);
+    static bool postOrders(QSqlDatabase& db, const QString& orderIds, const QVariantList& values, QVariantList& balances);
+    static bool adjust(QSqlDatabase& db, qlonglong productId, int quantity, QVariantList& balances);
+
+private:
+    static bool readBalances(QSqlDatabase& db, const QString& productIds, const QVariantList& values, QVariantList& balances);
+};
+
+#endif // STOCKLEDGER_H
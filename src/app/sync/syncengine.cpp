@@ -0,0 +1,523 @@
+#include "syncengine.h"
+#include "synchub.h"
+#include "db/preparedquery.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QSqlRecord>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <climits>
+
+namespace {
+
+const char* const ConnectionName = "sync";
+
+const int BatchSize = 500;
+
+// Parents first, so that the order of a line is known by the time the line arrives.
+const char* const BaselineTables[] = { "products", "sales_orders", "sales_order_details" };
+const int BaselineTableCount = sizeof(BaselineTables) / sizeof(BaselineTables[0]);
+
+QDateTime parseDateTime(const QString& text)
+{
+    return QDateTime::fromString(QString(text).replace(' ', 'T'), Qt::ISODate);
+}
+
+}
+
+SyncEngine::SyncEngine(const QString& databaseName, SyncHub* hub, QObject* parent)
+    : QThread(parent)
+    , databaseName(databaseName)
+    , hub(hub)
+    , interval(0)
+    , requested(false)
+    , stopping(false)
+{
+    qRegisterMetaType<QList<qlonglong>>("QList<qlonglong>");
+}
+
+SyncEngine::~SyncEngine()
+{
+    stop();
+    delete hub;
+}
+
+void SyncEngine::start(int pInterval)
+{
+    QMutexLocker locker(&mutex);
+    interval = pInterval;
+    requested = true;
+
+    if (!isRunning())
+        QThread::start(LowPriority);
+}
+
+void SyncEngine::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        condition.wakeOne();
+    }
+
+    wait();
+}
+
+void SyncEngine::sync()
+{
+    QMutexLocker locker(&mutex);
+    requested = true;
+    condition.wakeOne();
+}
+
+void SyncEngine::run()
+{
+    {
+        db = QSqlDatabase::addDatabase("QSQLITE", ConnectionName);
+        db.setDatabaseName(databaseName);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        db.open();
+
+        terminal = state("terminal_id");
+
+        forever {
+            {
+                QMutexLocker locker(&mutex);
+                while (!requested && !stopping) {
+                    if (!condition.wait(&mutex, interval > 0 ? ulong(interval) : ULONG_MAX))
+                        break;
+                }
+
+                if (stopping)
+                    break;
+
+                requested = false;
+            }
+
+            if (!terminal.isEmpty()) {
+                while (exportBaseline());
+                while (exportChanges());
+                importChanges();
+            }
+
+            emit synced();
+        }
+
+        PreparedQuery::clearCache(ConnectionName);
+        db.close();
+        db = QSqlDatabase();
+    }
+
+    QSqlDatabase::removeDatabase(ConnectionName);
+}
+
+// Rows that predate the change log were never logged. The migration reserved a sequence number for each and
+// noted the highest id per table; they go out once, table by table, ahead of the logged changes.
+bool SyncEngine::exportBaseline()
+{
+    const qlonglong baselineSeq = state("baseline_seq").toLongLong();
+    const qlonglong lastSeq = state("last_exported_seq").toLongLong();
+    if (lastSeq >= baselineSeq)
+        return false;
+
+    const QString current = state("baseline_table");
+    int tableIndex = 0;
+    while (!current.isEmpty() && tableIndex < BaselineTableCount && current != BaselineTables[tableIndex])
+        tableIndex++;
+
+    qlonglong afterId = state("baseline_id").toLongLong();
+    QJsonArray changes;
+
+    while (tableIndex < BaselineTableCount && changes.size() < BatchSize) {
+        const QString table = BaselineTables[tableIndex];
+        const int limit = BatchSize - changes.size();
+
+        QList<qlonglong> ids;
+        {
+            PreparedQuery q(QString("select id from %1 where id>? and id<=? order by id limit ?").arg(table), db);
+            q->bindValue(0, afterId);
+            q->bindValue(1, state("baseline_max_id:" + table).toLongLong());
+            q->bindValue(2, limit);
+            q->exec();
+            while (q->next())
+                ids.append(q->value(0).toLongLong());
+        }
+
+        for (qlonglong id: ids) {
+            afterId = id;
+
+            QJsonObject change;
+            change.insert("table", table);
+            if (!describe(table, id, change))
+                continue;
+
+            const Key key = globalKey(table, id);
+            change.insert("op", QString("U"));
+            change.insert("origin", key.first);
+            change.insert("id", QString::number(key.second));
+            changes.append(change);
+        }
+
+        if (ids.size() < limit) {
+            tableIndex++;
+            afterId = 0;
+        }
+    }
+
+    // Rows deleted since the migration leave reserved numbers unused; the last batch claims them all.
+    const bool done = tableIndex == BaselineTableCount;
+    const qlonglong seq = done ? baselineSeq : qMin(lastSeq + changes.size(), baselineSeq - 1);
+
+    QJsonObject batch;
+    batch.insert("terminal", terminal);
+    batch.insert("last_seq", QString::number(seq));
+    batch.insert("changes", changes);
+
+    if (!hub->push(terminal, seq, QJsonDocument(batch).toJson(QJsonDocument::Compact)))
+        return false;
+
+    db.transaction();
+    setState("last_exported_seq", QString::number(seq));
+    setState("baseline_table", done ? QString() : QString(BaselineTables[tableIndex]));
+    setState("baseline_id", QString::number(afterId));
+    db.commit();
+    return !done;
+}
+
+bool SyncEngine::exportChanges()
+{
+    // Only the latest state of each row travels, however often it changed.
+    QList<Key> rows;
+    QHash<Key, Logged> loggedByRow;
+    qlonglong lastSeq = 0;
+    {
+        // Deletions carry the time they were logged, in the same local time as lastmod_datetime.
+        PreparedQuery q("select seq, table_name, row_id, op, datetime(logged_datetime, 'localtime'), parent_id"
+                        " from change_log where origin='' and seq>? order by seq limit ?", db);
+        q->bindValue(0, state("last_exported_seq").toLongLong());
+        q->bindValue(1, BatchSize);
+        q->exec();
+
+        while (q->next()) {
+            lastSeq = q->value(0).toLongLong();
+            const Key row(q->value(1).toString(), q->value(2).toLongLong());
+            if (!loggedByRow.contains(row))
+                rows.append(row);
+
+            Logged logged;
+            logged.op = q->value(3).toString();
+            logged.datetime = q->value(4).toString();
+            logged.parentId = q->value(5).toLongLong();
+            loggedByRow.insert(row, logged);
+        }
+    }
+
+    if (lastSeq == 0)
+        return false;
+
+    QJsonArray changes;
+    for (const Key& row: rows) {
+        const Logged logged = loggedByRow.value(row);
+        QJsonObject change;
+        change.insert("table", row.first);
+
+        if (logged.op == "D" || !describe(row.first, row.second, change)) {
+            if (row.first == "products")
+                continue;
+            change.insert("op", QString("D"));
+            change.insert("deleted_datetime", logged.datetime);
+            if (row.first == "sales_order_details" && logged.parentId != 0)
+                describeParent(logged.parentId, change);
+        }
+        else
+            change.insert("op", QString("U"));
+
+        const Key key = globalKey(row.first, row.second);
+        change.insert("origin", key.first);
+        change.insert("id", QString::number(key.second));
+        changes.append(change);
+    }
+
+    QJsonObject batch;
+    batch.insert("terminal", terminal);
+    batch.insert("last_seq", QString::number(lastSeq));
+    batch.insert("changes", changes);
+
+    if (!hub->push(terminal, lastSeq, QJsonDocument(batch).toJson(QJsonDocument::Compact)))
+        return false;
+
+    setState("last_exported_seq", QString::number(lastSeq));
+    return true;
+}
+
+bool SyncEngine::describe(const QString& table, qlonglong id, QJsonObject& change)
+{
+    PreparedQuery q(QString("select * from %1 where id=?").arg(table), db);
+    q->bindValue(0, id);
+    q->exec();
+    if (!q->next())
+        return false;
+
+    QJsonObject row;
+    const QSqlRecord record = q->record();
+    for (int i = 0; i < record.count(); i++) {
+        if (record.fieldName(i) != "id")
+            row.insert(record.fieldName(i), QJsonValue::fromVariant(record.value(i)));
+    }
+
+    // Product ids are local to each till; the receiving side resolves the line's product by name.
+    if (table == "sales_order_details") {
+        row.remove("parent_id");
+        row.remove("product_id");
+        describeParent(record.value("parent_id").toLongLong(), change);
+    }
+
+    change.insert("row", row);
+    return true;
+}
+
+void SyncEngine::describeParent(qlonglong parentId, QJsonObject& change)
+{
+    const Key parent = globalKey("sales_orders", parentId);
+    change.insert("parent_origin", parent.first);
+    change.insert("parent_id", QString::number(parent.second));
+
+    PreparedQuery parentLastMod("select lastmod_datetime from sales_orders where id=?", db);
+    parentLastMod->bindValue(0, parentId);
+    parentLastMod->exec();
+    if (parentLastMod->next())
+        change.insert("parent_lastmod", parentLastMod->value(0).toString());
+}
+
+void SyncEngine::importChanges()
+{
+    QList<qlonglong> orderIds;
+
+    for (const QString& origin: hub->terminals()) {
+        if (origin == terminal)
+            continue;
+
+        const QString seqKey = "imported_seq:" + origin;
+        for (const SyncHub::Batch& batch: hub->pull(origin, state(seqKey).toLongLong())) {
+            db.transaction();
+
+            // Rows written while applying are logged under the remote origin so they are never exported back.
+            setState("origin", origin);
+            bool ok = applyBatch(origin, QJsonDocument::fromJson(batch.second).object(), orderIds);
+            setState("origin", "");
+
+            if (ok) {
+                setState(seqKey, QString::number(batch.first));
+                ok = db.commit();
+            }
+
+            if (!ok) {
+                db.rollback();
+                qWarning() << "Sync: failed to apply batch" << batch.first << "from" << origin;
+                break;
+            }
+        }
+    }
+
+    if (!orderIds.isEmpty())
+        emit imported(orderIds);
+}
+
+bool SyncEngine::applyBatch(const QString& origin, const QJsonObject& batch, QList<qlonglong>& orderIds)
+{
+    if (batch.value("terminal").toString() != origin)
+        return false;
+
+    for (const QJsonValue& change: batch.value("changes").toArray()) {
+        if (!applyChange(change.toObject(), orderIds))
+            return false;
+    }
+
+    return true;
+}
+
+bool SyncEngine::applyChange(const QJsonObject& change, QList<qlonglong>& orderIds)
+{
+    const QString table = change.value("table").toString();
+    const Key key(change.value("origin").toString(), change.value("id").toString().toLongLong());
+    const QJsonObject row = change.value("row").toObject();
+    qlonglong id = localId(table, key);
+
+    if (table == "products") {
+        PreparedQuery q("insert or ignore into products (name) values (?)", db);
+        q->bindValue(0, row.value("name").toString());
+        return q->exec();
+    }
+    else if (table != "sales_orders" && table != "sales_order_details")
+        return true;
+
+    // Conflicts are settled by the order's lastmod_datetime: the newer side wins, for deletions as well.
+    // A line is judged by its order, and a deletion by when it was logged.
+    qlonglong orderId = id;
+    QString remoteLastMod = row.value("lastmod_datetime").toString();
+    if (table == "sales_order_details") {
+        orderId = localId("sales_orders", Key(change.value("parent_origin").toString(),
+                                              change.value("parent_id").toString().toLongLong()));
+        remoteLastMod = change.value("parent_lastmod").toString();
+    }
+
+    if (change.value("op").toString() == "D") {
+        if (id == 0)
+            return true;
+
+        if (remoteLastMod.isEmpty() || table == "sales_orders")
+            remoteLastMod = change.value("deleted_datetime").toString();
+
+        if (orderId != 0 && isNewerLocally(orderId, remoteLastMod))
+            return true;
+
+        PreparedQuery q(QString("delete from %1 where id=?").arg(table), db);
+        q->bindValue(0, id);
+        if (!q->exec())
+            return false;
+
+        if (table == "sales_orders") {
+            PreparedQuery details("delete from sales_order_details where parent_id=?", db);
+            details->bindValue(0, id);
+            orderIds.append(id);
+            return details->exec();
+        }
+
+        if (orderId != 0)
+            orderIds.append(orderId);
+        return true;
+    }
+
+    QJsonObject values = row;
+    if (table == "sales_order_details") {
+        if (orderId == 0)
+            return true;
+
+        values.insert("parent_id", QString::number(orderId));
+
+        PreparedQuery product("select id from products where name=?", db);
+        product->bindValue(0, row.value("name").toString());
+        product->exec();
+        values.insert("product_id", product->next() ? QJsonValue(product->value(0).toLongLong()) : QJsonValue());
+    }
+
+    if (orderId != 0 && isNewerLocally(orderId, remoteLastMod))
+        return true;
+
+    if (!write(table, id, values))
+        return false;
+
+    if (localId(table, key) != id && key.first != terminal) {
+        PreparedQuery q("insert or replace into sync_row_map (origin, table_name, origin_id, local_id) values (?, ?, ?, ?)", db);
+        q->bindValue(0, key.first);
+        q->bindValue(1, table);
+        q->bindValue(2, key.second);
+        q->bindValue(3, id);
+        if (!q->exec())
+            return false;
+    }
+
+    orderIds.append(table == "sales_orders" ? id : orderId);
+    return true;
+}
+
+bool SyncEngine::isNewerLocally(qlonglong orderId, const QString& remoteLastMod)
+{
+    PreparedQuery q("select lastmod_datetime from sales_orders where id=?", db);
+    q->bindValue(0, orderId);
+    q->exec();
+    return q->next() && parseDateTime(q->value(0).toString()) > parseDateTime(remoteLastMod);
+}
+
+bool SyncEngine::write(const QString& table, qlonglong& localId, const QJsonObject& row)
+{
+    const QSqlRecord record = db.record(table);
+
+    QStringList columns;
+    for (const QString& column: row.keys()) {
+        if (column != "id" && record.contains(column))
+            columns.append(column);
+    }
+
+    if (localId != 0) {
+        PreparedQuery q(QString("select 1 from %1 where id=?").arg(table), db);
+        q->bindValue(0, localId);
+        q->exec();
+        if (!q->next())
+            localId = 0;
+    }
+
+    QString sql;
+    if (localId == 0) {
+        sql = QString("insert into %1(%2) values (:%3)").arg(table, columns.join(", "), columns.join(",:"));
+    }
+    else {
+        QStringList assignments;
+        for (const QString& column: columns)
+            assignments.append(column + "=:" + column);
+        sql = QString("update %1 set %2 where id=:id").arg(table, assignments.join(","));
+    }
+
+    PreparedQuery q(sql, db);
+    for (const QString& column: columns)
+        q->bindValue(":" + column, row.value(column).toVariant());
+
+    if (localId != 0)
+        q->bindValue(":id", localId);
+
+    if (!q->exec())
+        return false;
+
+    if (localId == 0)
+        localId = q->lastInsertId().toLongLong();
+
+    return true;
+}
+
+SyncEngine::Key SyncEngine::globalKey(const QString& table, qlonglong localId)
+{
+    PreparedQuery q("select origin, origin_id from sync_row_map where table_name=? and local_id=?", db);
+    q->bindValue(0, table);
+    q->bindValue(1, localId);
+    q->exec();
+
+    if (q->next())
+        return Key(q->value(0).toString(), q->value(1).toLongLong());
+
+    return Key(terminal, localId);
+}
+
+qlonglong SyncEngine::localId(const QString& table, const Key& key)
+{
+    if (key.first == terminal)
+        return key.second;
+
+    PreparedQuery q("select local_id from sync_row_map where origin=? and table_name=? and origin_id=?", db);
+    q->bindValue(0, key.first);
+    q->bindValue(1, table);
+    q->bindValue(2, key.second);
+    q->exec();
+
+    return q->next() ? q->value(0).toLongLong() : 0;
+}
+
+QString SyncEngine::state(const QString& key) const
+{
+    PreparedQuery q("select value from sync_state where key=?", db);
+    q->bindValue(0, key);
+    q->exec();
+
+    return q->next() ? q->value(0).toString() : QString();
+}
+
+void SyncEngine::setState(const QString& key, const QString& value)
+{
+    PreparedQuery q("insert or replace into sync_state (key, value) values (?, ?)", db);
+    q->bindValue(0, key);
+    q->bindValue(1, value);
+    q->exec();
+}
@@ -0,0 +1,73 @@
+#ifndef SYNCENGINE_H
+#define SYNCENGINE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSqlDatabase>
+#include <QPair>
+
+class QJsonObject;
+class SyncHub;
+
+// Exchanges change batches with the hub on a thread and connection of its own, so that a slow hub or a
+// large import never blocks the GUI. Imported orders are reported back through imported().
+class SyncEngine : public QThread
+{
+    Q_OBJECT
+public:
+    SyncEngine(const QString& databaseName, SyncHub* hub, QObject* parent = 0);
+    ~SyncEngine();
+
+    void start(int interval);
+    void stop();
+
+signals:
+    void imported(const QList<qlonglong>& orderIds);
+    void synced();
+
+public slots:
+    void sync();
+
+protected:
+    void run();
+
+private:
+    typedef QPair<QString, qlonglong> Key;
+
+    struct Logged
+    {
+        QString op;
+        QString datetime;
+        qlonglong parentId;
+    };
+
+    bool exportBaseline();
+    bool exportChanges();
+    void importChanges();
+    bool applyBatch(const QString& origin, const QJsonObject& batch, QList<qlonglong>& orderIds);
+    bool applyChange(const QJsonObject& change, QList<qlonglong>& orderIds);
+    bool describe(const QString& table, qlonglong id, QJsonObject& change);
+    void describeParent(qlonglong parentId, QJsonObject& change);
+    bool isNewerLocally(qlonglong orderId, const QString& remoteLastMod);
+    bool write(const QString& table, qlonglong& localId, const QJsonObject& row);
+
+    Key globalKey(const QString& table, qlonglong localId);
+    qlonglong localId(const QString& table, const Key& key);
+    QString state(const QString& key) const;
+    void setState(const QString& key, const QString& value);
+
+    QString databaseName;
+    SyncHub* hub;
+    QMutex mutex;
+    QWaitCondition condition;
+    int interval;
+    bool requested;
+    bool stopping;
+
+    // Only used on the sync thread.
+    QSqlDatabase db;
+    QString terminal;
+};
+
+#endif // SYNCENGINE_H
@@ -0,0 +1,47 @@
+#include "synchub.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+DirectorySyncHub::DirectorySyncHub(const QString& path)
+    : dir(path)
+{
+}
+
+bool DirectorySyncHub::push(const QString& terminalId, qlonglong lastSeq, const QByteArray& batch)
+{
+    if (!dir.mkpath(terminalId))
+        return false;
+
+    QSaveFile file(dir.filePath(QString("%1/%2.json").arg(terminalId).arg(lastSeq, 12, 10, QChar('0'))));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(batch);
+    return file.commit();
+}
+
+QStringList DirectorySyncHub::terminals()
+{
+    return dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+}
+
+QList<SyncHub::Batch> DirectorySyncHub::pull(const QString& terminalId, qlonglong afterSeq)
+{
+    QList<Batch> batches;
+
+    QDir terminalDir(dir.filePath(terminalId));
+    for (const QString& fileName: terminalDir.entryList(QStringList("*.json"), QDir::Files, QDir::Name)) {
+        qlonglong lastSeq = fileName.section('.', 0, 0).toLongLong();
+        if (lastSeq <= afterSeq)
+            continue;
+
+        QFile file(terminalDir.filePath(fileName));
+        if (!file.open(QIODevice::ReadOnly))
+            break;
+
+        batches.append(Batch(lastSeq, file.readAll()));
+    }
+
+    return batches;
+}
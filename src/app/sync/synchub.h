@@ -0,0 +1,35 @@
+#ifndef SYNCHUB_H
+#define SYNCHUB_H
+
+#include <QDir>
+#include <QList>
+#include <QPair>
+#include <QByteArray>
+#include <QStringList>
+
+class SyncHub
+{
+public:
+    typedef QPair<qlonglong, QByteArray> Batch;
+
+    virtual ~SyncHub() {}
+
+    virtual bool push(const QString& terminalId, qlonglong lastSeq, const QByteArray& batch) = 0;
+    virtual QStringList terminals() = 0;
+    virtual QList<Batch> pull(const QString& terminalId, qlonglong afterSeq) = 0;
+};
+
+class DirectorySyncHub : public SyncHub
+{
+public:
+    DirectorySyncHub(const QString& path);
+
+    bool push(const QString& terminalId, qlonglong lastSeq, const QByteArray& batch);
+    QStringList terminals();
+    QList<Batch> pull(const QString& terminalId, qlonglong afterSeq);
+
+private:
+    QDir dir;
+};
+
+#endif // SYNCHUB_H
@@ -1,5 +1,5 @@
 TEMPLATE = subdirs
 CONFIG += ordered
-SUBDIRS = \ 
-    app
-    
\ No newline at end of file
+SUBDIRS = \
+    app \
+    tests
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_benchmarks
+DEFINES += BASELINE_FILE=\\\"$$PWD/baseline.ini\\\"
+SOURCES += \
+    tst_benchmarks.cpp
@@ -0,0 +1,352 @@
+#include "testdatabase.h"
+#include "sales/salesordermodel.h"
+#include "sales/salesorderproxymodel.h"
+#include "sales/salesordereditor.h"
+
+#include <QtTest>
+#include <QApplication>
+#include <QSettings>
+#include <QTableView>
+#include <QPrinter>
+#include <QDialog>
+
+namespace {
+
+const int OrderCounts[] = { 1000, 10000, 100000 };
+
+// Percent slower than the baseline at which a benchmark fails, unless BILZIA_BENCHMARK_THRESHOLD says otherwise.
+const double DefaultThreshold = 20.0;
+
+// A save that has not come back by then has hung.
+const int SaveTimeout = 60 * 1000;
+
+}
+
+// Times the hot paths against a seeded database of one size and compares each result with the stored
+// baseline. BILZIA_BENCHMARK_BASELINE names another baseline file, and BILZIA_BENCHMARK_UPDATE=1 records
+// the new numbers instead of comparing.
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+public:
+    Benchmarks(int orderCount);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void modelRefreshAll();
+    void modelRefresh();
+    void modelData();
+    void proxyFilter();
+    void proxySortText();
+    void proxySortInteger();
+    void editorLoad();
+    void editorSetData();
+    void editorSave();
+    void editorPrint();
+
+private:
+    void compareWithBaseline(qint64 nsecs, int runs);
+    static int columnOf(QAbstractItemModel* model, const QString& label);
+
+    int orderCount;
+    TestDatabase* database;
+    SalesOrderModel* model;
+    QSettings* baseline;
+    double threshold;
+    bool updateBaseline;
+};
+
+Benchmarks::Benchmarks(int orderCount)
+    : orderCount(orderCount)
+    , database(0)
+    , model(0)
+    , baseline(0)
+    , threshold(DefaultThreshold)
+    , updateBaseline(qgetenv("BILZIA_BENCHMARK_UPDATE") == "1")
+{
+}
+
+void Benchmarks::initTestCase()
+{
+    const QByteArray baselineFile = qgetenv("BILZIA_BENCHMARK_BASELINE");
+    baseline = new QSettings(baselineFile.isEmpty() ? QString(BASELINE_FILE) : QString::fromLocal8Bit(baselineFile),
+                             QSettings::IniFormat);
+
+    bool ok = false;
+    const double t = qgetenv("BILZIA_BENCHMARK_THRESHOLD").toDouble(&ok);
+    if (ok)
+        threshold = t;
+
+    qDebug() << "Seeding" << orderCount << "orders";
+    database = new TestDatabase(orderCount);
+    model = new SalesOrderModel(0);
+    model->refreshAll(-1);
+}
+
+void Benchmarks::cleanupTestCase()
+{
+    if (updateBaseline)
+        baseline->sync();
+
+    delete model;
+    delete database;
+    delete baseline;
+}
+
+void Benchmarks::compareWithBaseline(qint64 nsecs, int runs)
+{
+    QVERIFY(runs > 0);
+
+    const double usecs = nsecs / 1000.0 / runs;
+    const QString key = QString("%1/%2").arg(orderCount).arg(QTest::currentTestFunction());
+
+    if (updateBaseline) {
+        baseline->setValue(key, usecs);
+        return;
+    }
+
+    const double expected = baseline->value(key).toDouble();
+    if (expected <= 0)
+        QFAIL(qPrintable(QString("No baseline for %1 in %2; record one with BILZIA_BENCHMARK_UPDATE=1")
+                         .arg(key, baseline->fileName())));
+
+    const double percent = (usecs - expected) * 100.0 / expected;
+    QVERIFY2(percent <= threshold, qPrintable(QString("%1 took %2 usec, %3% slower than the baseline of %4 usec")
+                                              .arg(key).arg(usecs, 0, 'f', 1).arg(percent, 0, 'f', 1).arg(expected, 0, 'f', 1)));
+}
+
+int Benchmarks::columnOf(QAbstractItemModel* model, const QString& label)
+{
+    for (int column = 0; column < model->columnCount(); column++) {
+        if (model->headerData(column, Qt::Horizontal).toString() == label)
+            return column;
+    }
+
+    return -1;
+}
+
+void Benchmarks::modelRefreshAll()
+{
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        model->refreshAll(-1);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::modelRefresh()
+{
+    QList<qlonglong> ids;
+    for (int i = 1; i <= orderCount; i += qMax(1, orderCount / 100))
+        ids.append(i);
+
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        model->refresh(ids);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::modelData()
+{
+    const int rows = qMin(model->rowCount(), 5000);
+
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < model->columnCount(); column++)
+                model->data(model->index(row, column));
+        }
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::proxyFilter()
+{
+    if (model->isServerSide())
+        QSKIP("Filtering is done by SQLite at this size");
+
+    SalesOrderProxyModel proxyModel(0);
+    proxyModel.setSourceModel(model);
+
+    bool filtered = false;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        filtered = !filtered;
+        if (filtered)
+            proxyModel.setFilterWildcard("*budi*");
+        else
+            proxyModel.setFilterFixedString(QString());
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::proxySortText()
+{
+    if (model->isServerSide())
+        QSKIP("Sorting is done by SQLite at this size");
+
+    SalesOrderProxyModel proxyModel(0);
+    proxyModel.setSourceModel(model);
+
+    bool descending = false;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        descending = !descending;
+        proxyModel.sort(SalesOrderModel::CustomerNameColumn, descending ? Qt::DescendingOrder : Qt::AscendingOrder);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::proxySortInteger()
+{
+    if (model->isServerSide())
+        QSKIP("Sorting is done by SQLite at this size");
+
+    SalesOrderProxyModel proxyModel(0);
+    proxyModel.setSourceModel(model);
+
+    bool descending = false;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        descending = !descending;
+        proxyModel.sort(SalesOrderModel::GrandTotalColumn, descending ? Qt::DescendingOrder : Qt::AscendingOrder);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::editorLoad()
+{
+    const qlonglong orderId = database->largeOrderId();
+
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        SalesOrderEditor editor(orderId, 0);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::editorSetData()
+{
+    SalesOrderEditor editor(database->largeOrderId(), 0);
+    QAbstractItemModel* editorModel = editor.findChild<QTableView*>()->model();
+    const int quantityColumn = columnOf(editorModel, "Kwantitas");
+    QVERIFY(quantityColumn >= 0);
+
+    // Every edit also brings the running total up to date.
+    int quantity = 1;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        quantity = quantity % 5 + 1;
+        for (int row = 0; row < 50; row++)
+            editorModel->setData(editorModel->index(row, quantityColumn), quantity);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::editorSave()
+{
+    SalesOrderEditor editor(database->largeOrderId(), 0);
+    QAbstractItemModel* editorModel = editor.findChild<QTableView*>()->model();
+    const int quantityColumn = columnOf(editorModel, "Kwantitas");
+    QVERIFY(quantityColumn >= 0);
+
+    int quantity = 1;
+    bool failed = false;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        if (failed)
+            continue;
+
+        quantity = quantity % 5 + 1;
+        editorModel->setData(editorModel->index(0, quantityColumn), quantity);
+
+        // A failed save shows a modal warning; dismiss it so that the run fails instead of hanging.
+        QEventLoop loop;
+        QTimer timeout;
+        connect(&editor, &SalesOrderEditor::saved, &loop, &QEventLoop::quit);
+        connect(&editor, &SalesOrderEditor::saveFailed, &loop, [&loop, &failed]() {
+            failed = true;
+            QTimer::singleShot(0, []() {
+                if (QDialog* dialog = qobject_cast<QDialog*>(QApplication::activeModalWidget()))
+                    dialog->reject();
+            });
+            loop.quit();
+        });
+        connect(&timeout, &QTimer::timeout, &loop, [&loop, &failed]() {
+            failed = true;
+            loop.quit();
+        });
+        timeout.start(SaveTimeout);
+
+        editor.save();
+        loop.exec();
+        runs++;
+    }
+
+    QVERIFY2(!failed, "Saving the order failed or timed out");
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+void Benchmarks::editorPrint()
+{
+    SalesOrderEditor editor(database->largeOrderId(), 0);
+    QTemporaryDir dir;
+    const QString pdfFile = dir.path() + "/order.pdf";
+
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        QPrinter printer;
+        printer.setOutputFormat(QPrinter::PdfFormat);
+        printer.setOutputFileName(pdfFile);
+        editor.print(&printer);
+        runs++;
+    }
+    compareWithBaseline(timer.nsecsElapsed(), runs);
+}
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QLocale::setDefault(QLocale(QLocale::Indonesian, QLocale::Indonesia));
+
+    int status = 0;
+    for (int orderCount: OrderCounts) {
+        Benchmarks benchmarks(orderCount);
+        status |= QTest::qExec(&benchmarks, argc, argv);
+    }
+
+    return status;
+}
+
+#include "tst_benchmarks.moc"
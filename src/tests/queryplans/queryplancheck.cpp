@@ -0,0 +1,192 @@
+#include "queryplancheck.h"
+
+#include <QFile>
+#include <QRegularExpression>
+
+#include <sqlite3.h>
+
+namespace {
+
+// Tables that grow with every sale; a scan of any of them gets slower month by month.
+const char* const LargeTables[] = {
+    "sales_orders", "sales_order_details", "stock_movements", "change_log", "sync_row_map"
+};
+
+struct AllowedScan
+{
+    const char* table;
+    const char* pattern;
+    const char* reason;
+};
+
+// Scans that are the point of the statement. Patterns are matched against the whole statement text.
+const AllowedScan AllowedScans[] = {
+    { "sales_orders", "^select \\(select count\\(\\*\\) from main\\.sales_orders\\)"
+                      "( \\+ \\(select count\\(\\*\\) from archive\\.sales_orders\\))?$",
+      "the unfiltered list shows how many orders there are in total" },
+    { "sales_orders", "^select id, cast\\(julianday",
+      "the analytics snapshot reads every order once per load" },
+    { "sales_order_details", "^select parent_id, name, quantity, cast\\(round",
+      "the analytics snapshot reads every order line once per load" },
+};
+
+}
+
+QueryPlanCheck::QueryPlanCheck(const QString& databaseName, const QString& archiveName)
+    : db(0)
+{
+    if (sqlite3_open_v2(QFile::encodeName(databaseName).constData(), &db, SQLITE_OPEN_READONLY, 0) != SQLITE_OK) {
+        error = db ? QString::fromUtf8(sqlite3_errmsg(db)) : QString("out of memory");
+        sqlite3_close(db);
+        db = 0;
+        return;
+    }
+
+    if (!archiveName.isEmpty() && !exec("attach database ? as archive", archiveName)) {
+        sqlite3_close(db);
+        db = 0;
+    }
+}
+
+QueryPlanCheck::~QueryPlanCheck()
+{
+    sqlite3_close(db);
+}
+
+QStringList QueryPlanCheck::check(const QStringList& statements, QStringList* allowed)
+{
+    QStringList failures;
+
+    // Statements on temp tables can only be planned once the tables exist on this connection as well.
+    for (const QString& sql: statements) {
+        if (sql.startsWith("create temp table") && !exec(sql))
+            failures.append(QString("FAILED  %1: %2").arg(sql, error));
+    }
+
+    for (const QString& sql: statements) {
+        if (sql.startsWith("create "))
+            continue;
+
+        const QList<Step> steps = plan(sql);
+        if (!error.isEmpty()) {
+            failures.append(QString("FAILED  %1: %2").arg(sql, error));
+            continue;
+        }
+
+        for (const Step& step: steps) {
+            const QString table = scannedTable(step.detail, sql);
+            if (table.isEmpty())
+                continue;
+
+            if (isOrderedWindow(steps, step, sql)) {
+                if (allowed)
+                    allowed->append(QString("ALLOWED %1: the window walks an index in sort order and stops at the limit").arg(sql));
+                continue;
+            }
+
+            if (const char* reason = allowedReason(table, sql)) {
+                if (allowed)
+                    allowed->append(QString("ALLOWED %1: %2").arg(sql, reason));
+                continue;
+            }
+
+            failures.append(QString("SCAN    %1: %2").arg(sql, step.detail));
+        }
+    }
+
+    return failures;
+}
+
+bool QueryPlanCheck::exec(const QString& sql, const QString& argument)
+{
+    const QByteArray text = sql.toUtf8();
+    sqlite3_stmt* statement = 0;
+    if (sqlite3_prepare_v2(db, text.constData(), text.size(), &statement, 0) != SQLITE_OK) {
+        error = QString::fromUtf8(sqlite3_errmsg(db));
+        return false;
+    }
+
+    const QByteArray value = argument.toUtf8();
+    if (!argument.isNull())
+        sqlite3_bind_text(statement, 1, value.constData(), value.size(), SQLITE_TRANSIENT);
+
+    const int rc = sqlite3_step(statement);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+        error = QString::fromUtf8(sqlite3_errmsg(db));
+
+    sqlite3_finalize(statement);
+    return rc == SQLITE_DONE || rc == SQLITE_ROW;
+}
+
+QList<QueryPlanCheck::Step> QueryPlanCheck::plan(const QString& sql)
+{
+    QList<Step> steps;
+    error.clear();
+
+    // Parameters are left unbound; the plan depends on the statement, not on the values.
+    const QByteArray explain = "explain query plan " + sql.toUtf8();
+    sqlite3_stmt* statement = 0;
+    if (sqlite3_prepare_v2(db, explain.constData(), explain.size(), &statement, 0) != SQLITE_OK) {
+        error = QString::fromUtf8(sqlite3_errmsg(db));
+        return steps;
+    }
+
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        Step step;
+        step.id = sqlite3_column_int(statement, 0);
+        step.parent = sqlite3_column_int(statement, 1);
+        step.detail = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(statement, 3)));
+        steps.append(step);
+    }
+
+    sqlite3_finalize(statement);
+    return steps;
+}
+
+QString QueryPlanCheck::scannedTable(const QString& detail, const QString& sql)
+{
+    // "SCAN t", "SCAN TABLE t" on older SQLite, and "SCAN t USING [COVERING] INDEX i" all visit every row.
+    static const QRegularExpression scan("^SCAN (?:TABLE )?(?:\\w+\\.)?(\\w+)");
+    const QRegularExpressionMatch match = scan.match(detail);
+    if (!match.hasMatch())
+        return QString();
+
+    // Plans name aliased tables by their alias.
+    const QString name = match.captured(1);
+    for (const char* table: LargeTables) {
+        if (name == table)
+            return name;
+
+        const QRegularExpression alias(QString("\\b%1\\s+(?:as\\s+)?%2\\b").arg(table, name),
+                                       QRegularExpression::CaseInsensitiveOption);
+        if (alias.match(sql).hasMatch())
+            return table;
+    }
+
+    return QString();
+}
+
+bool QueryPlanCheck::isOrderedWindow(const QList<Step>& steps, const Step& scan, const QString& sql)
+{
+    // A scan along an index that already yields the sort order stops after the limit. Sorting into a
+    // temp b-tree instead reads every row before the first one comes out, however small the limit.
+    if (!scan.detail.contains(" USING ") || !sql.contains(" limit "))
+        return false;
+
+    for (const Step& step: steps) {
+        if (step.parent == scan.parent && step.detail.contains("TEMP B-TREE FOR") && step.detail.contains("ORDER BY"))
+            return false;
+    }
+
+    return true;
+}
+
+const char* QueryPlanCheck::allowedReason(const QString& table, const QString& sql)
+{
+    for (const AllowedScan& scan: AllowedScans) {
+        if (table == scan.table && QRegularExpression(scan.pattern).match(sql).hasMatch())
+            return scan.reason;
+    }
+
+    return 0;
+}
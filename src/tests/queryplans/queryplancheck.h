@@ -0,0 +1,43 @@
+#ifndef QUERYPLANCHECK_H
+#define QUERYPLANCHECK_H
+
+#include <QStringList>
+
+struct sqlite3;
+
+// Runs EXPLAIN QUERY PLAN on statements the application prepared and reports every full scan of a large
+// table that is not on the allowlist. Plans come from a read-only connection of its own, opened through the
+// SQLite library the tests link, never from a handle of the Qt driver.
+class QueryPlanCheck
+{
+public:
+    QueryPlanCheck(const QString& databaseName, const QString& archiveName = QString());
+    ~QueryPlanCheck();
+
+    inline bool isOpen() const { return db != 0; }
+    inline QString errorString() const { return error; }
+
+    // Returns one line per unexpected scan or statement that cannot be planned; allowed scans are added to allowed.
+    QStringList check(const QStringList& statements, QStringList* allowed = 0);
+
+private:
+    Q_DISABLE_COPY(QueryPlanCheck)
+
+    struct Step
+    {
+        int id;
+        int parent;
+        QString detail;
+    };
+
+    bool exec(const QString& sql, const QString& argument = QString());
+    QList<Step> plan(const QString& sql);
+    static QString scannedTable(const QString& detail, const QString& sql);
+    static bool isOrderedWindow(const QList<Step>& steps, const Step& scan, const QString& sql);
+    static const char* allowedReason(const QString& table, const QString& sql);
+
+    sqlite3* db;
+    QString error;
+};
+
+#endif // QUERYPLANCHECK_H
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+TARGET = tst_queryplans
+SOURCES += \
+    queryplancheck.cpp \
+    tst_queryplans.cpp
+
+HEADERS += \
+    queryplancheck.h
@@ -0,0 +1,370 @@
+#include "testdatabase.h"
+#include "queryplancheck.h"
+#include "db/preparedquery.h"
+#include "db/writequeue.h"
+#include "db/changewatcher.h"
+#include "db/archiver.h"
+#include "sales/salesordermodel.h"
+#include "sales/salesordersearch.h"
+#include "sales/salesordereditor.h"
+#include "sales/salesordermanager.h"
+#include "stock/stockledger.h"
+#include "customers/customerdirectory.h"
+#include "sync/syncengine.h"
+#include "sync/synchub.h"
+#include "analytics/salessnapshot.h"
+
+#include <QtTest>
+#include <QApplication>
+#include <QTableView>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <functional>
+
+namespace {
+
+// Enough orders for the list to page on the server side.
+const int OrderCount = 60000;
+
+const int Timeout = 60 * 1000;
+
+}
+
+// Drives every feature that talks to the database against a seeded one, with PreparedQuery recording what
+// it prepares, then checks the query plan of each recorded statement for full scans of the large tables.
+// Migrations are left out: they run once, against tables that later steps rename or drop, so they cannot
+// be planned against the final schema, and rewriting whole tables is what they are for.
+class QueryPlans : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void orderList();
+    void productSearch();
+    void editor();
+    void bulkActions();
+    void stockLedger();
+    void customers();
+    void changes();
+    void sync();
+    void analytics();
+    void archive();
+    void plans();
+
+private:
+    void browse(SalesOrderModel& model, int stateFilter);
+    static bool runSync(SyncEngine& engine, const std::function<void()>& trigger);
+    static int columnOf(QAbstractItemModel* model, const QString& label);
+    static qlonglong value(const QString& sql);
+
+    TestDatabase* database = 0;
+};
+
+void QueryPlans::initTestCase()
+{
+    PreparedQuery::setRecording(true);
+    database = new TestDatabase(OrderCount);
+}
+
+void QueryPlans::cleanupTestCase()
+{
+    PreparedQuery::setRecording(false);
+    delete database;
+}
+
+void QueryPlans::browse(SalesOrderModel& model, int stateFilter)
+{
+    model.refreshAll(stateFilter);
+    QVERIFY(model.isServerSide() || stateFilter != -1);
+
+    // Windows from both ends and from the middle, scrolling forward and back.
+    for (int column = 0; column < model.columnCount(); column++) {
+        for (Qt::SortOrder order: { Qt::AscendingOrder, Qt::DescendingOrder }) {
+            model.sort(column, order);
+            const int rows = model.rowCount();
+            for (int row: { 0, 300, rows / 2, rows / 2 - 300, rows - 1 }) {
+                if (row >= 0 && row < rows)
+                    model.data(model.index(row, column));
+            }
+        }
+    }
+}
+
+void QueryPlans::orderList()
+{
+    SalesOrderModel model(0);
+    for (int stateFilter = -1; stateFilter <= 2; stateFilter++)
+        browse(model, stateFilter);
+
+    model.refreshAll(-1);
+    model.setSearchText("budi");
+    model.data(model.index(0, 0));
+    model.setSearchText(QString());
+
+    model.setDateRange(QDate(2016, 1, 1), QDate(2016, 12, 31));
+    model.data(model.index(0, 0));
+    model.setDateRange(QDate(), QDate());
+
+    model.refresh(QList<qlonglong>() << 1 << OrderCount / 2 << OrderCount);
+}
+
+void QueryPlans::productSearch()
+{
+    SalesOrderModel model(0);
+    model.refreshAll(-1);
+
+    SalesOrderSearch* search = model.findChild<SalesOrderSearch*>();
+    QVERIFY(search);
+    QSignalSpy spy(search, SIGNAL(searchFinished(int,int)));
+
+    model.setProductSearch(true);
+    model.setSearchText("produk 01");
+    QVERIFY(spy.count() > 0 || spy.wait(Timeout));
+
+    SalesOrderSearch::countHits("produk 01", QList<qlonglong>() << 1 << 2 << 3);
+}
+
+void QueryPlans::editor()
+{
+    SalesOrderEditor editor(database->largeOrderId(), 0);
+    QAbstractItemModel* editorModel = editor.findChild<QTableView*>()->model();
+    const int quantityColumn = columnOf(editorModel, "Kwantitas");
+    QVERIFY(quantityColumn >= 0);
+
+    editorModel->setData(editorModel->index(0, quantityColumn), 2);
+
+    QSignalSpy spy(&editor, SIGNAL(saved(qlonglong)));
+    editor.save();
+    QVERIFY(spy.wait(Timeout));
+}
+
+void QueryPlans::bulkActions()
+{
+    QSignalSpy spy(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)));
+
+    const SalesOrderManager::BulkAction actions[] = {
+        SalesOrderManager::CompleteOrders, SalesOrderManager::CancelOrders, SalesOrderManager::RemoveOrders
+    };
+
+    qlonglong id = 10;
+    for (SalesOrderManager::BulkAction action: actions) {
+        const QList<qlonglong> ids = QList<qlonglong>() << id << id + 1 << id + 2;
+        id += 3;
+
+        WriteQueue::instance()->submit(SalesOrderManager::bulkJob(ids, action, QDateTime::currentDateTime()));
+        QVERIFY(spy.wait(Timeout));
+        QVERIFY(spy.last().at(1).toBool());
+    }
+}
+
+void QueryPlans::stockLedger()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    QVariantList balances;
+
+    // Posted and undone, so that later steps see the seeded stock.
+    db.transaction();
+    QVERIFY(StockLedger::postOrder(db, OrderCount / 2, balances));
+    QVERIFY(StockLedger::adjust(db, 1, 5, balances));
+    db.rollback();
+}
+
+void QueryPlans::customers()
+{
+    CustomerDirectory::instance()->backfill();
+}
+
+void QueryPlans::changes()
+{
+    ChangeWatcher watcher(0);
+    watcher.start(Timeout);
+
+    QSignalSpy spy(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)));
+    WriteQueue::instance()->submit([](QSqlDatabase& db, QVariantMap&) {
+        QSqlQuery q(db);
+        return q.exec("update sales_orders set customer_name='Budi' where id=20")
+            && q.exec("delete from sales_order_details where parent_id=21");
+    });
+    QVERIFY(spy.wait(Timeout));
+
+    watcher.poll();
+}
+
+void QueryPlans::sync()
+{
+    // Export starts near the end of the change log rather than from the seeded history, with a small
+    // baseline of the first rows of each table ahead of it.
+    const qlonglong seq = value("select max(seq) from change_log");
+    QMap<QString, QVariant> states;
+    states.insert("terminal_id", "kasir-1");
+    states.insert("last_exported_seq", seq - 700);
+    states.insert("baseline_seq", seq - 100);
+    states.insert("baseline_max_id:products", 200);
+    states.insert("baseline_max_id:sales_orders", 200);
+    states.insert("baseline_max_id:sales_order_details", 200);
+
+    QSqlQuery q;
+    q.prepare("insert or replace into sync_state (key, value) values (?, ?)");
+    for (QMap<QString, QVariant>::const_iterator it = states.constBegin(); it != states.constEnd(); ++it) {
+        q.bindValue(0, it.key());
+        q.bindValue(1, it.value());
+        QVERIFY(q.exec());
+    }
+
+    QTemporaryDir dir;
+    SyncEngine engine(database->databaseName(), new DirectorySyncHub(dir.path()), 0);
+    QVERIFY(runSync(engine, [&engine]() { engine.start(Timeout); }));
+
+    // A peer creates an order with a line, edits it, then removes it.
+    QJsonObject order;
+    order.insert("table", QString("sales_orders"));
+    order.insert("origin", QString("kasir-2"));
+    order.insert("id", QString("7"));
+    order.insert("op", QString("U"));
+    QJsonObject row;
+    row.insert("state", 0);
+    row.insert("customer_name", QString("Siti"));
+    row.insert("lastmod_datetime", QDateTime::currentDateTime().toString(Qt::ISODate));
+    order.insert("row", row);
+
+    QJsonObject line;
+    line.insert("table", QString("sales_order_details"));
+    line.insert("origin", QString("kasir-2"));
+    line.insert("id", QString("70"));
+    line.insert("op", QString("U"));
+    line.insert("parent_origin", QString("kasir-2"));
+    line.insert("parent_id", QString("7"));
+    line.insert("parent_lastmod", row.value("lastmod_datetime"));
+    QJsonObject lineRow;
+    lineRow.insert("name", QString("Produk 001"));
+    lineRow.insert("quantity", 1);
+    line.insert("row", lineRow);
+
+    QJsonObject lineRemoval = line;
+    lineRemoval.insert("op", QString("D"));
+    lineRemoval.insert("deleted_datetime", row.value("lastmod_datetime"));
+    lineRemoval.remove("row");
+
+    QJsonObject removal = order;
+    removal.insert("op", QString("D"));
+    removal.insert("deleted_datetime", row.value("lastmod_datetime"));
+    removal.remove("row");
+
+    QJsonObject batch;
+    batch.insert("terminal", QString("kasir-2"));
+    batch.insert("last_seq", QString("3"));
+    batch.insert("changes", QJsonArray() << order << line << order << lineRemoval << removal);
+
+    DirectorySyncHub peer(dir.path());
+    QVERIFY(peer.push("kasir-2", 3, QJsonDocument(batch).toJson(QJsonDocument::Compact)));
+    QVERIFY(runSync(engine, [&engine]() { engine.sync(); }));
+    engine.stop();
+
+    QCOMPARE(value("select count(*) from sync_row_map where origin='kasir-2'"), qlonglong(2));
+}
+
+void QueryPlans::analytics()
+{
+    QVERIFY(SalesSnapshot::load(database->databaseName()).orderCount() > 0);
+}
+
+void QueryPlans::archive()
+{
+    QSignalSpy spy(WriteQueue::instance(), SIGNAL(finished(int,bool,QVariantMap)));
+
+    QVERIFY(Archiver::attach(QSqlDatabase::database(), true));
+    WriteQueue::instance()->submit(Archiver::archiveJob(0, QDate::currentDate()));
+    QVERIFY(spy.wait(Timeout));
+    QVERIFY(spy.last().at(1).toBool());
+    QVERIFY(spy.last().at(2).toMap().value("count").toInt() > 0);
+
+    const qlonglong id = value("select min(id) from archive.sales_orders");
+    QVERIFY(Archiver::contains(id));
+
+    // An archived order is read from the archive, and goes back to the hot database only to be edited.
+    {
+        SalesOrderEditor editor(id, 0, true);
+        QSignalSpy restored(&editor, SIGNAL(restored(qlonglong)));
+        editor.restore();
+        QVERIFY(restored.wait(Timeout));
+    }
+    QVERIFY(!Archiver::contains(id));
+
+    // With an archive attached the list and the snapshot read both databases.
+    SalesOrderModel model(0);
+    for (int stateFilter: { -1, 1, 2 })
+        browse(model, stateFilter);
+
+    model.refreshAll(-1);
+    model.setSearchText("budi");
+    model.data(model.index(0, 0));
+
+    QVERIFY(SalesSnapshot::load(database->databaseName()).orderCount() > 0);
+}
+
+void QueryPlans::plans()
+{
+    QString archiveName;
+    QSqlQuery q("pragma database_list");
+    while (q.next()) {
+        if (q.value(1).toString() == "archive")
+            archiveName = q.value(2).toString();
+    }
+
+    QueryPlanCheck check(database->databaseName(), archiveName);
+    QVERIFY2(check.isOpen(), qPrintable(check.errorString()));
+
+    const QStringList statements = PreparedQuery::recordedStatements();
+    QStringList allowed;
+    const QStringList failures = check.check(statements, &allowed);
+
+    for (const QString& line: allowed)
+        qDebug() << qPrintable(line);
+
+    qDebug() << statements.size() << "statement(s) checked," << allowed.size() << "allowed scan(s)";
+    QVERIFY2(failures.isEmpty(), qPrintable(failures.join("\n")));
+}
+
+// The engine signals from its own thread, so the wait is set up before the pass is triggered.
+bool QueryPlans::runSync(SyncEngine& engine, const std::function<void()>& trigger)
+{
+    bool synced = false;
+    QEventLoop loop;
+    QTimer timeout;
+    connect(&engine, &SyncEngine::synced, &loop, [&loop, &synced]() {
+        synced = true;
+        loop.quit();
+    }, Qt::QueuedConnection);
+    connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    timeout.start(Timeout);
+    trigger();
+    loop.exec();
+    return synced;
+}
+
+int QueryPlans::columnOf(QAbstractItemModel* model, const QString& label)
+{
+    for (int column = 0; column < model->columnCount(); column++) {
+        if (model->headerData(column, Qt::Horizontal).toString() == label)
+            return column;
+    }
+
+    return -1;
+}
+
+qlonglong QueryPlans::value(const QString& sql)
+{
+    QSqlQuery q(sql);
+    return q.next() ? q.value(0).toLongLong() : 0;
+}
+
+QTEST_MAIN(QueryPlans)
+
+#include "tst_queryplans.moc"
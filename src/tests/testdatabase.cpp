@@ -0,0 +1,118 @@
+#include "testdatabase.h"
+#include "db/schema.h"
+#include "db/writequeue.h"
+#include "db/preparedquery.h"
+#include "products/productcatalog.h"
+#include "customers/customerdirectory.h"
+#include "sales/salesordereditorproductmodel.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QDateTime>
+
+namespace {
+
+const char* const CustomerNames[] = { "Budi", "Siti", "Agus", "Dewi", "Rina", "Joko", "Wati", "Andi" };
+
+}
+
+TestDatabase::TestDatabase(int orderCount)
+    : orders(orderCount)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+        db.setDatabaseName(databaseName());
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        db.open();
+        QSqlQuery(db).exec("pragma journal_mode=wal");
+        Schema::upgrade(db);
+    }
+
+    seed();
+
+    writeQueue = new WriteQueue(databaseName());
+    writeQueue->start();
+
+    catalog = new ProductCatalog(0);
+    catalog->reload();
+    productModel = new SalesOrderEditor::ProductModel(0);
+    customerDirectory = new CustomerDirectory(0);
+    customerDirectory->reload();
+}
+
+TestDatabase::~TestDatabase()
+{
+    delete customerDirectory;
+    delete productModel;
+    delete catalog;
+
+    writeQueue->stop();
+    delete writeQueue;
+
+    PreparedQuery::clearCache();
+    QSqlDatabase::database(QSqlDatabase::defaultConnection).close();
+    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+}
+
+void TestDatabase::seed()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery q(db);
+
+    db.transaction();
+
+    q.prepare("insert into products (name, cost, price) values (?, ?, ?)");
+    for (int i = 0; i < ProductCount; i++) {
+        q.bindValue(0, QString("Produk %1").arg(i, 3, 10, QChar('0')));
+        q.bindValue(1, 1000 + i * 100);
+        q.bindValue(2, 1500 + i * 150);
+        q.exec();
+    }
+
+    QSqlQuery order(db);
+    order.prepare("insert into sales_orders (state, open_datetime, grand_total, customer_name, customer_contact,"
+                  " customer_address, lastmod_datetime) values (?, ?, ?, ?, ?, ?, ?)");
+
+    QSqlQuery line(db);
+    line.prepare("insert into sales_order_details (parent_id, name, quantity, cost, price, profit, product_id)"
+                 " values (?, ?, ?, ?, ?, ?, ?)");
+
+    // Deterministic data so that runs compare like for like.
+    quint32 random = 12345;
+    const auto next = [&random]() { random = random * 1103515245 + 12345; return (random >> 16) & 0x7fff; };
+
+    const QDateTime start(QDate(2015, 1, 1), QTime(8, 0));
+    for (int i = 0; i < orders; i++) {
+        const bool large = i == orders - 1;
+        const int lineCount = large ? LargeOrderLines : LinesPerOrder;
+        const QDateTime openDateTime = start.addSecs(qint64(i) * 3600 * 24 * 365 * 5 / orders);
+
+        order.bindValue(0, next() % 3);
+        order.bindValue(1, openDateTime);
+        order.bindValue(2, 0);
+        order.bindValue(3, QString("%1 %2").arg(CustomerNames[next() % 8]).arg(next() % 1000));
+        order.bindValue(4, QString("08%1").arg(next() * 1000 + next() % 1000));
+        order.bindValue(5, QString("Jl. Merdeka No. %1").arg(next() % 200));
+        order.bindValue(6, openDateTime);
+        order.exec();
+        const qlonglong orderId = order.lastInsertId().toLongLong();
+
+        for (int j = 0; j < lineCount; j++) {
+            const int product = next() % ProductCount;
+            const int quantity = 1 + next() % 5;
+            line.bindValue(0, orderId);
+            line.bindValue(1, QString("Produk %1").arg(product, 3, 10, QChar('0')));
+            line.bindValue(2, quantity);
+            line.bindValue(3, 1000 + product * 100);
+            line.bindValue(4, 1500 + product * 150);
+            line.bindValue(5, quantity * (500 + product * 50));
+            line.bindValue(6, product + 1);
+            line.exec();
+        }
+    }
+
+    q.exec("update sales_orders set grand_total=(select coalesce(sum(quantity * price), 0)"
+           " from sales_order_details where parent_id=sales_orders.id)");
+
+    db.commit();
+}
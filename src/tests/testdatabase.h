@@ -0,0 +1,43 @@
+#ifndef TESTDATABASE_H
+#define TESTDATABASE_H
+
+#include <QTemporaryDir>
+#include <QString>
+
+class WriteQueue;
+class ProductCatalog;
+class CustomerDirectory;
+class QObject;
+
+// A temporary database seeded with deterministic orders and the singletons the models and editors expect:
+// the default connection, the writer queue, the product catalog and the customer directory.
+class TestDatabase
+{
+public:
+    TestDatabase(int orderCount);
+    ~TestDatabase();
+
+    inline QString databaseName() const { return dir.path() + "/bilzia-pos.sqlite3"; }
+    inline int orderCount() const { return orders; }
+
+    // The last order is the large one.
+    inline qlonglong largeOrderId() const { return orders; }
+
+    static const int LinesPerOrder = 3;
+    static const int ProductCount = 200;
+    static const int LargeOrderLines = 500;
+
+private:
+    Q_DISABLE_COPY(TestDatabase)
+
+    void seed();
+
+    QTemporaryDir dir;
+    int orders;
+    WriteQueue* writeQueue;
+    ProductCatalog* catalog;
+    QObject* productModel;
+    CustomerDirectory* customerDirectory;
+};
+
+#endif // TESTDATABASE_H
@@ -0,0 +1,13 @@
+include(../global.pri)
+include(../app/app.pri)
+
+QT += testlib
+CONFIG += testcase console
+CONFIG -= app_bundle
+TEMPLATE = app
+INCLUDEPATH += $$PWD
+SOURCES += \
+    $$PWD/testdatabase.cpp
+
+HEADERS += \
+    $$PWD/testdatabase.h